@@ -0,0 +1,669 @@
+/*
+Batch analysis of a measurements tree, the statistics of analyse.py without the plots.
+
+Every folder with NNNmm.csv files (i.e. measurements/infrared/cartoncinobianco) is a surface; when the calibration
+also wrote the dataset of the surface (measurements/infrared/cartoncinobianco.caldata) the steps are read from it.
+For each surface it writes in the "stats" folder:
+    stats.csv                               valore,media,devstd,error (same file of analyse.py)
+    dev_std_media.txt, dev_std_max.txt      mean and maximum standard deviation (same files of analyse.py)
+    fit.csv                                 slope,intercept,r2 of the least squares line media = slope * valore + intercept
+    histograms.csv                          valore,bin_start,bin_end,density of every distance
+and a fits.csv with the line of every surface in the analysed folder. With --registry the lines are also written in a
+calibration registry (see distance_sensor/include/CalibrationRegistry.hpp) with the mean and variance of every surface
+at the --reference distance, so the sensors can recognise the surface in front of them.
+The partial statistics of every input file are kept in stats/.analysis_cache with the digest of the file: only the
+new or modified files are parsed again, the results of the surface are recomputed from the cached partials and the
+surfaces without changes are skipped.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csvlogger/Dataset.hpp"
+#include "statistics/Statistics.hpp"
+#include "distance_sensor/include/CalibrationRegistry.hpp"
+
+#define THREADS_COMMAND "threads"     // number of worker threads [--threads=COUNT]
+#define BINS_COMMAND "bins"           // bins of the histograms [--bins=COUNT]
+#define FORCE_COMMAND "force"         // analyse also the surfaces whose inputs didn't change [--force]
+#define REGISTRY_COMMAND "registry"   // write the calibration registry of all the surfaces [--registry=FILE]
+#define REFERENCE_COMMAND "reference" // distance of the signatures of the surfaces in the registry [--reference=MM]
+#define HELP_COMMAND "help"
+
+#define BINS_DEFAULT 20                   // same bins of the histograms of analyse.py
+#define REFERENCE_DEFAULT 50              // reference distance of the registry [mm], in the linear range of both sensors
+#define CACHE_FILE_NAME ".analysis_cache" // partial statistics of the input files, in the stats folder
+#define CACHE_VERSION "analisi-cache-1"
+#define DATASET_EXTENSION ".caldata"      // dataset written by the calibration next to the surface folder
+#define DISTANCE_COLUMN "distance"        // column of the distance in the csv files
+
+#define option_width 30
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// Statistics of the measurements of a distance, they can be saved and merged without the values
+struct DistanceStats
+{
+    double valore; // nominal distance [mm]
+    statistics::RunningStats stats;
+    double bin_start = 0;    // first edge of the histogram
+    double bin_width = 1;    // width of every bin
+    vector<uint64_t> counts; // values in each bin
+};
+
+// Input of a surface: a csv file of a distance or the whole dataset
+struct SurfaceInput
+{
+    fs::path path;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t hash = 0;
+    bool cached = false;             // distances restored from the cache, the file wasn't parsed
+    bool failed = false;             // the file couldn't be read, it's left out of the results and of the cache
+    vector<DistanceStats> distances; // one for a csv file, one for each step of a dataset
+};
+
+struct Surface
+{
+    fs::path folder;
+    string sensor;               // folder of the sensor, the one below "measurements"
+    string dataset_column;       // sensor column of the dataset, empty to read the csv files
+    vector<SurfaceInput> inputs; // sorted by path
+};
+
+struct Fit
+{
+    double slope = NAN, intercept = NAN, r2 = NAN;
+};
+
+map<string, string> parse_command_line(int argc, char *argv[], string &folder);
+void display_usage();
+void parallel_for(size_t count, unsigned int threads, const function<void(size_t)> &body);
+vector<Surface> find_surfaces(const fs::path &root);
+uint64_t hash_file(const fs::path &path);
+void stat_file(SurfaceInput &input);
+map<string, SurfaceInput> read_cache(const fs::path &folder, unsigned int bins);
+void write_cache(const Surface &surface, unsigned int bins);
+vector<DistanceStats> analyse_input(const Surface &surface, size_t input, unsigned int bins);
+DistanceStats analyse_values(double valore, const double *values, size_t count, unsigned int bins);
+Fit fit_line(const vector<DistanceStats> &distances);
+SurfaceModel surface_model(const Surface &surface, const vector<DistanceStats> &distances, const Fit &fit, float reference);
+void write_surface_results(const Surface &surface, const vector<DistanceStats> &distances, const Fit &fit);
+Fit read_fit(const fs::path &folder);
+
+int main(int argc, char *argv[])
+{
+    string folder;
+    map<string, string> options = parse_command_line(argc, argv, folder);
+    if (options.count(HELP_COMMAND) || folder.empty())
+    {
+        display_usage();
+        return folder.empty() && !options.count(HELP_COMMAND) ? 1 : 0;
+    }
+    unsigned int threads = options.count(THREADS_COMMAND) ? stoul(options[THREADS_COMMAND]) : max(1U, thread::hardware_concurrency());
+    unsigned int bins = options.count(BINS_COMMAND) ? stoul(options[BINS_COMMAND]) : BINS_DEFAULT;
+    bool force = options.count(FORCE_COMMAND) > 0;
+    float reference = options.count(REFERENCE_COMMAND) ? stof(options[REFERENCE_COMMAND]) : REFERENCE_DEFAULT;
+    CalibrationRegistry registry(reference);
+    if (threads == 0 || bins == 0)
+    {
+        cerr << "The number of threads and bins must be positive" << endl;
+        return 1;
+    }
+    if (!fs::is_directory(folder))
+    {
+        cerr << folder << " is not a valid directory." << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<Surface> surfaces = find_surfaces(folder);
+
+    // the digests of the last analysis, a different number of bins invalidates them
+    vector<map<string, SurfaceInput>> caches(surfaces.size());
+    for (size_t s = 0; s < surfaces.size() && !force; s++)
+        caches[s] = read_cache(surfaces[s].folder, bins);
+
+    // every input is checked against the cache in parallel and parsed only if its digest changed
+    vector<pair<size_t, size_t>> inputs; // (surface, input)
+    for (size_t s = 0; s < surfaces.size(); s++)
+    {
+        for (size_t i = 0; i < surfaces[s].inputs.size(); i++)
+            inputs.push_back({s, i});
+    }
+    parallel_for(inputs.size(), threads, [&](size_t k)
+                 {
+        Surface &surface = surfaces[inputs[k].first];
+        SurfaceInput &input = surface.inputs[inputs[k].second];
+        const map<string, SurfaceInput> &cache = caches[inputs[k].first];
+        auto cached = cache.find(input.path.filename().string());
+
+        // an exception would terminate the program from the worker: a bad file is reported and the rest analysed
+        try
+        {
+            // same size and modification time: the file isn't read at all
+            stat_file(input);
+            bool same_stat = cached != cache.end() && cached->second.size == input.size && cached->second.mtime_ns == input.mtime_ns;
+            input.hash = same_stat ? cached->second.hash : hash_file(input.path);
+            if (cached != cache.end() && cached->second.hash == input.hash)
+            {
+                input.distances = cached->second.distances;
+                input.cached = true;
+            }
+            else
+            {
+                input.distances = analyse_input(surface, inputs[k].second, bins);
+            }
+        }
+        catch (const exception &e)
+        {
+            input.failed = true;
+            cerr << "Skipping " + input.path.string() + ": " + e.what() + "\n";
+        } });
+
+    size_t failed = 0;
+    for (Surface &surface : surfaces)
+    {
+        auto first_failed = remove_if(surface.inputs.begin(), surface.inputs.end(), [](const SurfaceInput &input)
+                                      { return input.failed; });
+        failed += surface.inputs.end() - first_failed;
+        surface.inputs.erase(first_failed, surface.inputs.end());
+    }
+
+    map<string, Fit> fits;
+    size_t analysed = 0, parsed = 0, unreadable = 0;
+    for (size_t s = 0; s < surfaces.size(); s++)
+    {
+        Surface &surface = surfaces[s];
+        string name = fs::relative(surface.folder, folder).string();
+        if (surface.inputs.empty())
+        {
+            unreadable++;
+            continue;
+        }
+        // a surface changes when a file is new or modified, or when one of the cached files was removed
+        size_t surface_parsed = count_if(surface.inputs.begin(), surface.inputs.end(), [](const SurfaceInput &input)
+                                         { return !input.cached; });
+        parsed += surface_parsed;
+
+        vector<DistanceStats> distances;
+        for (const SurfaceInput &input : surface.inputs)
+            distances.insert(distances.end(), input.distances.begin(), input.distances.end());
+        sort(distances.begin(), distances.end(), [](const DistanceStats &a, const DistanceStats &b)
+             { return a.valore < b.valore; });
+
+        if (surface_parsed == 0 && caches[s].size() == surface.inputs.size())
+        {
+            // files touched without changes keep their results, the new times avoid hashing them again
+            bool touched = any_of(surface.inputs.begin(), surface.inputs.end(), [&](const SurfaceInput &input)
+                                  { return caches[s].at(input.path.filename().string()).mtime_ns != input.mtime_ns; });
+            if (touched)
+                write_cache(surface, bins);
+            fits[name] = read_fit(surface.folder);
+            if (isfinite(fits[name].slope) && fits[name].slope != 0)
+                registry.add(surface_model(surface, distances, fits[name], reference));
+            continue;
+        }
+
+        Fit fit = fit_line(distances);
+        // a flat line (i.e. a sensor always reading 0) can't be inverted by the sensor
+        if (isfinite(fit.slope) && fit.slope != 0)
+            registry.add(surface_model(surface, distances, fit, reference));
+        write_surface_results(surface, distances, fit);
+        write_cache(surface, bins);
+        fits[name] = fit;
+        analysed++;
+        cout << "Analysed: " << name << " (" << distances.size() << " distances, " << surface_parsed << " files parsed)" << endl;
+    }
+
+    ofstream fits_file(fs::path(folder) / "fits.csv");
+    fits_file << setprecision(10) << "surface,slope,intercept,r2\n";
+    for (const auto &fit : fits)
+        fits_file << fit.first << "," << fit.second.slope << "," << fit.second.intercept << "," << fit.second.r2 << "\n";
+
+    if (options.count(REGISTRY_COMMAND))
+    {
+        registry.save(options[REGISTRY_COMMAND]);
+        cout << "Calibration registry with " << registry.getModels().size() << " surfaces written to " << options[REGISTRY_COMMAND] << endl;
+    }
+
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << analysed << " surfaces analysed, " << surfaces.size() - analysed - unreadable << " unchanged, "
+         << parsed << " of " << inputs.size() << " inputs parsed (" << failed << " skipped) in " << fixed << setprecision(3) << elapsed << " s with " << threads << " threads" << endl;
+    return 0;
+}
+
+void parallel_for(size_t count, unsigned int threads, const function<void(size_t)> &body)
+{
+    // the workers take the next index until there are none left, so slow files don't stall the others
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < min<size_t>(threads, count); t++)
+    {
+        workers.emplace_back([&]()
+                             {
+            for (size_t k = next++; k < count; k = next++)
+                body(k); });
+    }
+    for (thread &worker : workers)
+        worker.join();
+}
+
+vector<Surface> find_surfaces(const fs::path &root)
+{
+    vector<Surface> surfaces;
+    vector<fs::path> folders = {root};
+    for (const fs::directory_entry &entry : fs::recursive_directory_iterator(root))
+    {
+        if (entry.is_directory() && entry.path().filename() != "stats" && entry.path().filename() != "plots")
+            folders.push_back(entry.path());
+    }
+    sort(folders.begin(), folders.end());
+
+    for (const fs::path &folder : folders)
+    {
+        if (fs::exists(folder / ".ignore"))
+            continue;
+
+        Surface surface;
+        surface.folder = folder;
+        // the calibration writes measurements/SENSOR/SURFACE, also with groups of surfaces in between
+        fs::path absolute = fs::absolute(folder).lexically_normal();
+        surface.sensor = folder.parent_path().filename().string();
+        for (fs::path ancestor = absolute.parent_path(); ancestor.has_relative_path(); ancestor = ancestor.parent_path())
+        {
+            if (ancestor.parent_path().filename() == "measurements")
+            {
+                surface.sensor = ancestor.filename().string();
+                break;
+            }
+        }
+        // the runs of many sensors (i.e. measurements/infrared+ultrasonic) only join the readings of a tick: every sensor
+        // writes the same steps in its own folder as well, which is analysed in their place
+        if (surface.sensor.find('+') != string::npos)
+            continue;
+        fs::path dataset_path = folder.parent_path() / (folder.filename().string() + DATASET_EXTENSION);
+        if (fs::exists(dataset_path))
+        {
+            // the dataset has a column for each sensor, the folder of the sensor is the parent of the surface
+            try
+            {
+                DatasetReader dataset(dataset_path.string());
+                surface.dataset_column = surface.sensor;
+                dataset.column(surface.dataset_column);
+                surface.inputs.push_back({dataset_path});
+            }
+            catch (const exception &e)
+            {
+                cerr << "Reading the csv files in place of " << dataset_path.string() << ": " << e.what() << endl;
+                surface.dataset_column.clear();
+            }
+        }
+        if (surface.inputs.empty())
+        {
+            for (const fs::directory_entry &entry : fs::directory_iterator(folder))
+            {
+                string name = entry.path().filename().string();
+                if (entry.is_regular_file() && name.size() > 6 && name.compare(name.size() - 6, 6, "mm.csv") == 0)
+                    surface.inputs.push_back({entry.path()});
+            }
+        }
+        if (surface.inputs.empty())
+            continue;
+        sort(surface.inputs.begin(), surface.inputs.end(), [](const SurfaceInput &a, const SurfaceInput &b)
+             { return a.path < b.path; });
+        surfaces.push_back(surface);
+    }
+    return surfaces;
+}
+
+// Maps a whole file read-only, returns nullptr for empty or unreadable files
+static const char *map_file(const fs::path &path, size_t &size)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat status;
+    size = fstat(fd, &status) == 0 ? status.st_size : 0;
+    void *mapping = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    return mapping == MAP_FAILED ? nullptr : static_cast<const char *>(mapping);
+}
+
+void stat_file(SurfaceInput &input)
+{
+    struct stat status;
+    if (stat(input.path.c_str(), &status) != 0)
+        return;
+    input.size = status.st_size;
+    input.mtime_ns = (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+}
+
+uint64_t hash_file(const fs::path &path)
+{
+    // FNV-1a of the name and of the content, renaming a distance changes the hash too
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : path.filename().string())
+        hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+
+    size_t size;
+    const char *data = map_file(path, size);
+    if (data == nullptr)
+        return hash;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ (uint8_t)data[i]) * 1099511628211ULL;
+    munmap(const_cast<char *>(data), size);
+    return hash;
+}
+
+vector<DistanceStats> analyse_input(const Surface &surface, size_t input, unsigned int bins)
+{
+    vector<DistanceStats> distances;
+    const fs::path &path = surface.inputs[input].path;
+    if (!surface.dataset_column.empty())
+    {
+        DatasetReader dataset(path.string());
+        size_t column = dataset.column(surface.dataset_column);
+        for (size_t step = 0; step < dataset.steps(); step++)
+            distances.push_back(analyse_values(dataset.stepKey(step), dataset.values(step, column), dataset.rows(step), bins));
+        return distances;
+    }
+
+    size_t size;
+    const char *data = map_file(path, size);
+    if (data == nullptr)
+        return distances;
+    const char *end = data + size;
+
+    // the header tells which field is the distance, the files of the calibration have only that column
+    const char *line_end = find(data, end, '\n');
+    string header(data, line_end);
+    if (!header.empty() && header.back() == '\r')
+        header.pop_back();
+    stringstream header_stream(header);
+    string field;
+    int distance_field = -1;
+    for (int f = 0; getline(header_stream, field, ','); f++)
+    {
+        if (field == DISTANCE_COLUMN)
+            distance_field = f;
+    }
+    if (distance_field < 0)
+    {
+        cerr << "No " << DISTANCE_COLUMN << " column in " << path.string() << endl;
+        munmap(const_cast<char *>(data), size);
+        return distances;
+    }
+
+    vector<double> values;
+    values.reserve(size / 4);
+    for (const char *p = min(line_end + 1, end); p < end;)
+    {
+        const char *next_line = find(p, end, '\n');
+        const char *q = p;
+        for (int f = 0; f < distance_field && q < next_line; f++)
+            q = find(q, next_line, ',') + 1;
+        double value;
+        if (q < next_line && from_chars(q, next_line, value).ec == errc())
+            values.push_back(value);
+        p = next_line + 1;
+    }
+    munmap(const_cast<char *>(data), size);
+
+    // the nominal distance is the number in the file name, i.e. 035mm.csv
+    string name = path.filename().string();
+    distances.push_back(analyse_values(stod(name.substr(0, name.size() - 6)), values.data(), values.size(), bins));
+    return distances;
+}
+
+DistanceStats analyse_values(double valore, const double *values, size_t count, unsigned int bins)
+{
+    DistanceStats distance;
+    distance.valore = valore;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!isnan(values[i]))
+            distance.stats.add(values[i]);
+    }
+    if (distance.stats.count() == 0)
+        return distance;
+
+    // bins between min and max like matplotlib, one unit wide range around constant values
+    double low = distance.stats.min(), high = distance.stats.max();
+    if (low == high)
+    {
+        low -= 0.5;
+        high += 0.5;
+    }
+    distance.bin_start = low;
+    distance.bin_width = (high - low) / bins;
+    distance.counts.assign(bins, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        double value = values[i];
+        if (isnan(value))
+            continue;
+        size_t bin = min<size_t>((size_t)((value - low) / distance.bin_width), bins - 1);
+        distance.counts[bin]++;
+    }
+    return distance;
+}
+
+Fit fit_line(const vector<DistanceStats> &distances)
+{
+    statistics::RunningStats x, y;
+    double sxy = 0;
+    for (const DistanceStats &distance : distances)
+    {
+        if (distance.stats.count() == 0)
+            continue;
+        // co-moment updated with the means before and after the new point (Welford)
+        double dx = distance.valore - x.mean();
+        x.add(distance.valore);
+        y.add(distance.stats.mean());
+        sxy += dx * (distance.stats.mean() - y.mean());
+    }
+
+    Fit fit;
+    if (x.count() < 2 || x.variance() == 0)
+        return fit;
+    double sxx = x.variance() * (x.count() - 1), syy = y.variance() * (y.count() - 1);
+    fit.slope = sxy / sxx;
+    fit.intercept = y.mean() - fit.slope * x.mean();
+    fit.r2 = syy > 0 ? sxy * sxy / (sxx * syy) : 1;
+    return fit;
+}
+
+SurfaceModel surface_model(const Surface &surface, const vector<DistanceStats> &distances, const Fit &fit, float reference)
+{
+    SurfaceModel model = {surface.sensor, surface.folder.filename().string(),
+                          (float)fit.slope, (float)fit.intercept, (float)fit.r2, 0, 0, 0};
+
+    // signature interpolated between the measured distances around the reference
+    const DistanceStats *below = nullptr, *above = nullptr;
+    for (const DistanceStats &distance : distances)
+    {
+        if (distance.stats.count() < 2)
+            continue;
+        if (distance.valore <= reference)
+            below = &distance;
+        if (distance.valore >= reference)
+        {
+            above = &distance;
+            break;
+        }
+    }
+    if (below == nullptr || above == nullptr)
+        return model;
+    double t = above->valore > below->valore ? (reference - below->valore) / (above->valore - below->valore) : 0;
+    model.reference_mean = below->stats.mean() + t * (above->stats.mean() - below->stats.mean());
+    model.reference_variance = below->stats.variance() + t * (above->stats.variance() - below->stats.variance());
+    model.reference_count = min(below->stats.count(), above->stats.count());
+    return model;
+}
+
+void write_surface_results(const Surface &surface, const vector<DistanceStats> &distances, const Fit &fit)
+{
+    fs::path stats_folder = surface.folder / "stats";
+    fs::create_directories(stats_folder);
+
+    ofstream stats(stats_folder / "stats.csv");
+    ofstream histograms(stats_folder / "histograms.csv");
+    stats << setprecision(16) << "valore,media,devstd,error\n";
+    histograms << setprecision(10) << "valore,bin_start,bin_end,density\n";
+    statistics::RunningStats stddevs;
+    for (const DistanceStats &distance : distances)
+    {
+        if (distance.stats.count() == 0)
+            continue;
+        stats << distance.valore << "," << distance.stats.mean() << "," << distance.stats.stddev() << ","
+              << distance.stats.mean() - distance.valore << "\n";
+        stddevs.add(distance.stats.stddev());
+        // densities like matplotlib, the histogram integrates to 1
+        for (size_t b = 0; b < distance.counts.size(); b++)
+            histograms << distance.valore << "," << distance.bin_start + b * distance.bin_width << ","
+                       << distance.bin_start + (b + 1) * distance.bin_width << ","
+                       << distance.counts[b] / (distance.stats.count() * distance.bin_width) << "\n";
+    }
+
+    ofstream(stats_folder / "dev_std_media.txt") << setprecision(16) << stddevs.mean();
+    ofstream(stats_folder / "dev_std_max.txt") << setprecision(16) << stddevs.max();
+    ofstream(stats_folder / "fit.csv") << setprecision(10) << "slope,intercept,r2\n"
+                                       << fit.slope << "," << fit.intercept << "," << fit.r2 << "\n";
+}
+
+/*
+Cache of a surface, text with every double at full precision so that the results from the cache are the same of a
+new analysis:
+    analisi-cache-1 BINS
+    input SIZE MTIME_NS HASH DISTANCES NAME
+    VALORE COUNT MEAN SQUARED_DEVIATIONS MIN MAX BIN_START BIN_WIDTH COUNT_1 ... COUNT_BINS     (DISTANCES lines)
+*/
+map<string, SurfaceInput> read_cache(const fs::path &folder, unsigned int bins)
+{
+    map<string, SurfaceInput> cache;
+    ifstream file(folder / "stats" / CACHE_FILE_NAME);
+    string version;
+    unsigned int cache_bins;
+    if (!(file >> version >> cache_bins) || version != CACHE_VERSION || cache_bins != bins)
+        return cache;
+
+    string tag;
+    while (file >> tag && tag == "input")
+    {
+        SurfaceInput input;
+        size_t distances;
+        string name;
+        if (!(file >> input.size >> input.mtime_ns >> input.hash >> distances) || !getline(file >> ws, name))
+            return {};
+        for (size_t d = 0; d < distances; d++)
+        {
+            DistanceStats distance;
+            uint64_t count;
+            double mean, squared_deviations, minimum, maximum;
+            file >> distance.valore >> count >> mean >> squared_deviations >> minimum >> maximum >> distance.bin_start >> distance.bin_width;
+            distance.stats = statistics::RunningStats::fromMoments(count, mean, squared_deviations, minimum, maximum);
+            distance.counts.resize(count > 0 ? bins : 0);
+            for (uint64_t &bin_count : distance.counts)
+                file >> bin_count;
+            input.distances.push_back(distance);
+        }
+        // a truncated cache is discarded, the surface is analysed from scratch
+        if (!file)
+            return {};
+        cache[name] = input;
+    }
+    return cache;
+}
+
+void write_cache(const Surface &surface, unsigned int bins)
+{
+    // written to a temporary file and renamed, an interrupted run never leaves a partial cache
+    fs::path cache_path = surface.folder / "stats" / CACHE_FILE_NAME;
+    fs::path temporary = cache_path;
+    temporary += ".tmp";
+    {
+        ofstream file(temporary);
+        file << setprecision(17) << CACHE_VERSION << " " << bins << "\n";
+        for (const SurfaceInput &input : surface.inputs)
+        {
+            file << "input " << input.size << " " << input.mtime_ns << " " << input.hash << " " << input.distances.size()
+                 << " " << input.path.filename().string() << "\n";
+            for (const DistanceStats &distance : input.distances)
+            {
+                file << distance.valore << " " << distance.stats.count() << " " << distance.stats.mean() << " "
+                     << distance.stats.squaredDeviations() << " " << distance.stats.min() << " " << distance.stats.max() << " "
+                     << distance.bin_start << " " << distance.bin_width;
+                for (uint64_t bin_count : distance.counts)
+                    file << " " << bin_count;
+                file << "\n";
+            }
+        }
+    }
+    fs::rename(temporary, cache_path);
+}
+
+Fit read_fit(const fs::path &folder)
+{
+    Fit fit;
+    ifstream fit_file(folder / "stats" / "fit.csv");
+    string header;
+    char comma;
+    if (getline(fit_file, header))
+        fit_file >> fit.slope >> comma >> fit.intercept >> comma >> fit.r2;
+    return fit;
+}
+
+map<string, string> parse_command_line(int argc, char *argv[], string &folder)
+{
+    map<string, string> options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "--")
+        {
+            size_t pos = arg.find('=');
+            string command = pos != string::npos ? arg.substr(2, pos - 2) : arg.substr(2);
+            options[command] = pos != string::npos ? arg.substr(pos + 1) : "";
+        }
+        else
+        {
+            folder = arg;
+        }
+    }
+
+    return options;
+}
+
+void display_usage()
+{
+    cout << "Usage: ./analisi /path/to/measurements/folder [OPTIONS]" << endl
+         << "Options:" << endl
+         << left
+         << "  --" << setw(option_width) << THREADS_COMMAND "=COUNT" << "Worker threads [default: one per core]" << endl
+         << "  --" << setw(option_width) << BINS_COMMAND "=COUNT" << "Bins of the histograms [default 20]" << endl
+         << "  --" << setw(option_width) << FORCE_COMMAND << "Analyse also the surfaces whose inputs didn't change" << endl
+         << "  --" << setw(option_width) << REGISTRY_COMMAND "=FILE" << "Write the calibration registry of all the surfaces" << endl
+         << "  --" << setw(option_width) << REFERENCE_COMMAND "=MM" << "Distance of the surface signatures in the registry [default 50]" << endl;
+}
@@ -9,16 +9,30 @@
 #include <cstring>
 #include <string>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
 
 #include "csvlogger/CsvLogger.hpp"
+#include "csvlogger/Dataset.hpp"
+#include "timebase/Timebase.hpp"
+#include "statistics/Statistics.hpp"
 #include "distance_sensor/include/DistanceSensor.hpp"
 #include "distance_sensor/include/UltrasonicSensor.hpp"
 #include "distance_sensor/include/InfraredSensor.hpp"
+#include "distance_sensor/include/SensorArray.hpp"
+#include "distance_sensor/include/CalibrationRegistry.hpp"
 #include "meca500_ethercat_cpp/Robot.hpp"
 
 #define HELP_COMMAND "help"
 #define CONFIG_FROM_FILE_COMMAND "config"
-#define SENSOR_COMMAND "sensor" // REQUIRED sensor specifier command [--sensor]
+#define SENSOR_COMMAND "sensor" // REQUIRED sensor specifier command, comma separated for many sensors [--sensor=infrared,ultrasonic]
 #define CALIBRATION_COMMAND "sensor_calibration"
 #define SURFACE_TYPE_COMMAND "surface"                // surface specifier [--surface="surface_name"]
 #define NUMBER_OF_MEASUREMENTS_COMMAND "measurements" // number of measurements per cycle [--measurements=number_of_measurements]
@@ -26,15 +40,42 @@
 #define MEASURE_DELAY_US_COMMAND "delay"              // delay between measurements in micro seconds [--delay=microseconds]
 #define ROBOT_STARTING_POSITION_COMMAND "position"    // starting pose of the meca500
 #define MEASUREMENTS_OPTIONS_COMMAND "options"        // command to set the measurement options [min_measurement,max_measurement,step_size]
+#define SWEEP_COMMAND "sweep"                         // continuous calibration moving the robot at constant velocity [--sweep=VELOCITY_MM_S]
+#define GPIO_COMMAND "gpio"                           // GPIO backend of the ultrasonic sensor [--gpio=pigpio|gpiod|simulated:PROFILE]
+#define BURST_COMMAND "burst"                         // every ultrasonic measurement is the filtered mean of a burst of pings [--burst=PINGS]
+#define PRECISION_COMMAND "precision"                 // stop measuring a step when the confidence interval on the mean is within +-MM [--precision=MM]
+#define REFINE_COMMAND "refine"                       // add distances where the calibration curve bends until the interpolation error is below MM [--refine=MM]
+#define REGISTRY_COMMAND "registry"                   // calibration registry written by analisi, to calibrate by surface name [--registry=FILE]
+#define DRY_RUN_COMMAND "dry_run"                     // check the options and print the estimated duration without measuring [--dry_run]
+#define ROBOT_LIMITS_COMMAND "robot_limits"           // velocity and acceleration of the robot assumed by the estimate [--robot_limits="{MM_S, MM_S2}"]
+#define RESUME_COMMAND "resume"                       // continue an interrupted run from its dataset, skipping the measured distances [--resume]
+#define PORT_COMMAND "port"                           // serial port of the infrared sensor, asked to the user if missing [--port=/dev/ttyUSB0]
+#define HEADLESS_COMMAND "headless"                   // never read stdin: the robot or the --fixture place the obstacle [--headless]
+#define FIXTURE_COMMAND "fixture"                     // command placing the obstacle without the robot or changing the surface [--fixture="COMMAND"]
+#define EVENTS_COMMAND "events"                       // appends the progress of the run to FILE as JSON lines [--events=FILE]
+#define BATCH_COMMAND "batch"                         // runs the jobs of FILE one after the other, headless [--batch=FILE]
 
 #define INFRARED_SENSOR_VALUE "infrared"     // infrared sensor specifier [--sensor=infrared]
 #define ULTRASONIC_SENSOR_VALUE "ultrasonic" // ultrasonic sensor specifier [--sensor=ultrasonic]
+#define CALIBRATION_AUTO_VALUE "auto"        // recognise the surface from the registry [--sensor_calibration=auto]
 
 /* DEFAULT VALUES */
 #define MEASUREMENTS_PER_CYCLE_DEFAULT 100   // default number of measurements per cycle
 #define ECHO_PIN 23                          // default ECHO GPIO PIN for the ultrasonic sensor
 #define TRIG_PIN 22                          // default TRIG GPIO PIN for the ultrasonic sensor
 #define MEASUREMENT_DELAY_US_DEFAULT 0.02e+6 // default delay between measurements in micro seconds
+#define SWEEP_POSE_POLL_US 1000              // polling period of the robot pose during a sweep in micro seconds
+#define SWEEP_TIMEOUT_MARGIN_S 2.0           // extra time allowed to a sweep before it is aborted in seconds
+#define ADAPTIVE_MIN_MEASUREMENTS 10         // measurements taken before testing the precision of a step
+#define PRECISION_CONFIDENCE 0.95            // confidence level of the interval tested against --precision
+#define REFINE_MIN_STEP_MM 1                 // the refinement adds whole millimetre distances, so steps can't be split below 2 mm
+#define REFINE_MAX_STEPS 100                 // maximum number of distances added by the refinement
+#define ROBOT_VELOCITY_DEFAULT 100           // cartesian velocity of the robot assumed by the estimate [mm/s]
+#define ROBOT_ACCELERATION_DEFAULT 200       // cartesian acceleration of the robot assumed by the estimate [mm/s^2]
+#define MOVE_POLL_DELAY_S 0.2                // Robot::move_pose waits 0.2 s, then checks the end of the movement every second
+#define MOVE_POLL_PERIOD_S 1.0
+#define INFRARED_SAMPLE_US 5000              // typical serial transaction of the infrared sensor (measure yours with ritardo)
+#define JOB_EVENTS_FD 3                      // descriptor on which the jobs of a batch write their events
 
 #define optionWidth 60
 #define descriptionWidth 60
@@ -62,6 +103,85 @@ stringstream robotMessage;
 
 stringstream calibrationMessage;
 
+stringstream sweepMessage;
+
+stringstream gpioMessage;
+
+stringstream burstMessage;
+
+stringstream precisionMessage;
+
+stringstream refineMessage;
+
+stringstream registryMessage;
+
+stringstream dryRunMessage;
+
+stringstream robotLimitsMessage;
+
+stringstream resumeMessage;
+
+stringstream portMessage;
+
+stringstream headlessMessage;
+
+stringstream fixtureMessage;
+
+stringstream eventsMessage;
+
+stringstream batchMessage;
+
+struct StampedPose
+{
+    int64_t timestamp_ns; // timeline time of the EtherCAT frame carrying the pose
+    float x;              // robot x coordinate in the WRF [mm]
+};
+
+struct StampedMeasurement
+{
+    int64_t timestamp_ns; // timeline time at which the sensor measured the distance
+    float distance;       // distance measured by the sensor [mm]
+    float nominal;        // obstacle distance computed from the interpolated robot pose [mm]
+};
+
+struct CalibrationPoint
+{
+    float distance;      // nominal obstacle distance [mm]
+    vector<float> means; // mean distance measured by each sensor of the array [mm], NAN without valid readings
+};
+
+// Whole configuration of a run: the option handlers only fill it, validate_spec() checks it before any
+// sensor or the robot is opened, so a dry run can print the plan and its duration without the hardware
+struct SweepSpec
+{
+    vector<string> sensors;                                     // sensor names, i.e. {infrared, ultrasonic}
+    string surface = "";                                        // surface name for saving measurements
+    float min_distance = 0;                                     // minimum distance to be measured [mm]
+    float max_distance = 170;                                   // maximum distance to be measured [mm]
+    float step = 5;                                             // step interval between measurements [mm], negative from max to min
+    float refine_error = 0;                                     // target interpolation error of the refinement [mm], 0 for the uniform grid only
+    unsigned int samples = MEASUREMENTS_PER_CYCLE_DEFAULT;      // measurements per step, the maximum with a target precision
+    float precision = 0;                                        // target half width of the confidence interval on the mean of a step [mm], 0 to take all the measurements
+    useconds_t delay_us = MEASUREMENT_DELAY_US_DEFAULT;         // delay between measurements, sets the sampling rate
+    unsigned int burst_pings = 0;                               // pings of each ultrasonic measurement, 0 for a single raw ping
+    string gpio_backend = "";                                   // GPIO backend of the ultrasonic sensor, empty for the default one
+    vector<float> robot_position = {200, -170, 120, 90, 90, 0}; // robot starting pose, the obstacle at zero distance
+    bool use_robot = false;                                     // move the obstacle with the meca500
+    float sweep_velocity = 0;                                   // robot velocity for the continuous calibration [mm/s], 0 to measure step by step
+    float robot_velocity = ROBOT_VELOCITY_DEFAULT;              // motion limits assumed by the estimate
+    float robot_acceleration = ROBOT_ACCELERATION_DEFAULT;
+    string registry = "";                                       // calibration registry written by analisi
+    vector<float> calibration_line;                             // {m, q} of every sensor, empty to keep the default line
+    string calibration_surface = "";                            // surface of the registry to calibrate with, or CALIBRATION_AUTO_VALUE
+    bool dry_run = false;                                       // stop after printing the plan and its duration
+    bool resume = false;                                        // continue the dataset of an interrupted run with the same options
+    string port = "";                                           // serial port of the infrared sensor, empty to ask or, headless, to use the first one
+    bool headless = false;                                      // never wait for the user
+    string fixture = "";                                        // command run as "COMMAND distance MM" and "COMMAND surface NAME"
+    string events = "";                                         // file of the JSON lines events, empty for none
+    string batch = "";                                          // job list, the other options are common to all the jobs
+};
+
 struct OptionHandler
 {
     using Handler = string (*)(string);
@@ -78,14 +198,41 @@ struct OptionHandler
 void display_usage();
 void setup_help_messages();
 void setup_handlers();
-int setup_options(map<string, string> options);
+int setup_options(map<string, string> options); // runs the handlers of the options, returns the number of invalid ones
+bool validate_spec();                            // checks the whole specification, printing every problem found
+void setup_run();                                // opens the sensors and the robot and applies the calibration
+double move_time(float distance);                // estimated duration of a robot movement [s]
+double sample_time();                            // estimated duration of a measurement of all the sensors [s]
+void print_estimate();                           // prints the plan of the run and its estimated duration
+string format_duration(double seconds);          // i.e. "1 h 5 min 20 s"
+string spec_hash();                              // digest of the options that change the measurements, stored in the dataset
+bool measured(float distance);                   // true if the distance has been measured by the run being resumed
+void place_obstacle(float distance);             // moves the robot, runs the fixture or asks the user to put the obstacle at a distance
+void run_fixture(const string &action, const string &argument);
+void fail(const string &message);                // prints the error, emits it as an event and exits
+string json_string(const string &text);
+void emit_event(const string &name, const string &fields); // fields is a JSON fragment, i.e. "\"distance\":10"
+int run_batch(int argc, char *argv[]);           // runs every job in a child process, returns the exit code of the program
+vector<vector<string>> parse_job_file(const string &job_file_path);
+int run_job(const vector<string> &arguments, int job, double *estimate_s); // returns the exit status of the job
 map<string, string> parse_command_line(int argc, char *argv[]);
 map<string, string> parse_config_file(string config_file_path);
 vector<float> parse_string_to_vector(string input);
+double parse_number(string input); // throws invalid_argument unless the whole string is a number
 void move_robot_to_position(vector<float> robot_position);
 void initialise_robot();
-void make_measurements(DistanceSensor &sensor, int number_of_measurements, vector<float> &measurements, unsigned int delay_us); // function to measure the distance with the given sensor
-void write_measurements_to_csv(vector<float> measurments, string file_path);
+vector<statistics::RunningStats> make_measurements(SensorArray &sensors, int number_of_measurements, vector<ArraySample> &measurements, unsigned int delay_us); // function to measure the distance with all the sensors together
+vector<float> measure_step(float distance); // positions the obstacle, measures and writes the csv files of a distance, returns the mean of each sensor
+float interpolation_error(const vector<CalibrationPoint> &points, size_t interval); // estimated error of the linear interpolation between two measured distances
+void refine_measurements(vector<CalibrationPoint> &points, int added); // measures new distances where the calibration curve bends most, added are already there
+void write_measurements_to_csv(const vector<ArraySample> &measurements, size_t sensor_index, string file_path);
+void write_joined_measurements_to_csv(const vector<ArraySample> &measurements, string file_path); // one row per tick with the distance of every sensor
+void open_dataset(string file_path);                                                           // creates the dataset of the run with the options as metadata
+void write_measurements_to_dataset(const vector<ArraySample> &measurements, float distance);   // adds the measurements of a distance to the dataset
+void make_sweep_measurements(SensorArray &sensors, float velocity, vector<vector<StampedMeasurement>> &measurements, unsigned int delay_us); // function to measure while the robot moves at constant velocity
+void interpolate_sweep_positions(vector<StampedMeasurement> &measurements, const vector<StampedPose> &poses, float origin_x);
+void write_sweep_to_csv(const vector<StampedMeasurement> &measurements, string file_path);
+void recognise_surface(); // measures the target at the reference distance of the registry and uses the calibration of the closest surface
 /************************************************/
 
 /*** COMMAND HANDLERS ***/
@@ -100,29 +247,40 @@ string handleDelay(string value);
 string handleConfig(string value);
 string handleNotFound(string value);
 string handleCalibration(string value);
+string handleSweep(string value);
+string handleGpio(string value);
+string handleBurst(string value);
+string handlePrecision(string value);
+string handleRefine(string value);
+string handleRegistry(string value);
+string handleDryRun(string value);
+string handleRobotLimits(string value);
+string handleResume(string value);
+string handlePort(string value);
+string handleHeadless(string value);
+string handleFixture(string value);
+string handleEvents(string value);
+string handleBatch(string value);
 /************************************************/
 
 /*** GLOBAL VARIABLES ***/
-useconds_t measurement_delay = MEASUREMENT_DELAY_US_DEFAULT; // delay between measurements in microseconds
-
-unsigned int number_of_measurements = MEASUREMENTS_PER_CYCLE_DEFAULT; // Number of measurements per cycle
-
-vector<float> default_robot_position = {200, -170, 120, 90, 90, 0}, // default robot starting position
-    robot_position(default_robot_position);                         // Robot starting position
+SweepSpec spec; // configuration of the run, see SweepSpec
 
-bool use_robot = false; // Flag to enable meca500 usage
+string sensor_type; // sensor names joined by "+" i.e. [infrared, ultrasonic, infrared+ultrasonic], folder of the run
 
-string sensor_type,        // sensor name to be used i.e. [infrared, ultrasonic]
-    surface_name = "",     // surface name for saving measurements
-    config_file_path = ""; // path to config file
+vector<float> robot_position; // current robot pose
+float robot_origin_x = 0;     // robot x with the obstacle at zero distance
 
-float min_measurement = 0, // minimum distance to be measured
-    max_measurement = 170, // maximum distance to be measured
-    step_size = 5,         // step interval between measurements
-    current_measurement;   // current distance to be measured
+string dataset_path;                      // dataset of the run, "measurements/SENSOR/SURFACE.caldata"
+vector<CalibrationPoint> measured_points; // steps found in the dataset of the run being resumed
+bool resumed_run = false;                 // the dataset of the run already exists
+FILE *events_file = nullptr;              // JSON lines events, see --events
 
-DistanceSensor *sensor = nullptr; // Sensor to use for measuring
-Robot *robot = nullptr;           // Robot object to handle meca500 communication
+SensorArray sensors;                     // Sensors to use for measuring, sampled together
+CalibrationRegistry *registry = nullptr; // Calibration models of the surfaces, loaded with --registry
+DatasetWriter *dataset = nullptr;        // Single file with all the steps of the run
+Robot *robot = nullptr;                  // Robot object to handle meca500 communication
+timebase::DcClock dc_clock;              // EtherCAT distributed clock mapped on the common timeline
 /************************************************/
 
 map<string, OptionHandler> optionHandlers;
@@ -133,87 +291,519 @@ int main(int argc, char *argv[])
     setup_help_messages();
     setup_handlers();
 
-    if (setup_options(parse_command_line(argc, argv)) != 0)
+    // every option is checked before opening the sensors or moving the robot
+    int invalid_options = setup_options(parse_command_line(argc, argv));
+    if (!spec.batch.empty() && invalid_options == 0)
+        return run_batch(argc, argv);
+    if (!validate_spec() || invalid_options != 0)
+    {
+        cerr << "Program will now exit..." << endl;
         return 1; // error
-
-    vector<float> measurements;                                                  // vector storing all the measurements
-    string file_path = "measurements/" + sensor_type + "/" + surface_name + "/"; // output file path
-    string csv_file_name;                                                        // name of output file
+    }
+    print_estimate();
+    if (spec.dry_run)
+        return 0;
+    setup_run();
+    emit_event("start", "\"sensor\":" + json_string(sensor_type) + ",\"surface\":" + json_string(spec.surface));
 
     /*MEASUREMENT*/
     cout << "Setup complete\nStarting measurements\n\n";
+    robot_origin_x = robot_position[0];
 
-    if (use_robot)
+    if (!spec.fixture.empty())
+        run_fixture("surface", spec.surface);
+    else if (spec.use_robot && !spec.headless)
     {
         cout << "Please position the obstacle in front of the sensor" << endl
              << "Press enter to continue..." << endl;
         getchar();
     }
 
-    getchar(); // hack to fix infrared sensor user input (endl in buffer)
+    // hack to fix infrared sensor user input (endl in buffer), only the selection of the sensor reads it
+    if (!spec.headless && spec.port.empty() && find(spec.sensors.begin(), spec.sensors.end(), INFRARED_SENSOR_VALUE) != spec.sensors.end())
+        getchar();
+
+    if (spec.calibration_surface == CALIBRATION_AUTO_VALUE)
+        recognise_surface();
+
+    if (resumed_run)
+        cout << "Resuming the run: " << measured_points.size() << " distances already measured\n\n";
 
-    while (current_measurement <= max_measurement && current_measurement >= min_measurement)
+    if (spec.sweep_velocity > 0)
     {
-        // setup for next set of measurements
-        measurements.clear();
-        csv_file_name = "";
-        csv_file_name += (current_measurement < 100 ? "0" : "");
-        csv_file_name += (current_measurement < 10 ? "0" : "");
-        csv_file_name += to_string((int)current_measurement) + "mm.csv";
+        vector<vector<StampedMeasurement>> sweep_measurements;
+        cout << "Sweeping from " << spec.min_distance << " mm to " << spec.max_distance << " mm at " << spec.sweep_velocity << " mm/s" << endl;
+        make_sweep_measurements(sensors, spec.sweep_velocity, sweep_measurements, spec.delay_us);
+        for (size_t i = 0; i < sensors.size(); i++)
+        {
+            cout << "Writing " << sweep_measurements[i].size() << " " << sensors.getName(i) << " measurements to csv file\n\n";
+            write_sweep_to_csv(sweep_measurements[i], "measurements/" + sensors.getName(i) + "/" + spec.surface + "/sweep.csv");
+            emit_event("sweep", "\"sensor\":" + json_string(sensors.getName(i)) + ",\"samples\":" + to_string(sweep_measurements[i].size()));
+        }
+        emit_event("end", "\"status\":\"ok\"");
+        return 0;
+    }
+
+    open_dataset(dataset_path);
+    // mean distance of every sensor at each measured distance, the steps of a resumed run are read from its dataset
+    vector<CalibrationPoint> points = measured_points;
+    int grid_measured = 0;
+    float current_measurement = spec.step > 0 ? spec.min_distance : spec.max_distance;
+    while (current_measurement <= spec.max_distance && current_measurement >= spec.min_distance)
+    {
+        if (measured(current_measurement))
+            grid_measured++;
+        else
+            points.push_back({current_measurement, measure_step(current_measurement)});
+        current_measurement += spec.step;
+    }
 
-        cout << "Currently measuring: " << current_measurement << " mm\n";
-        if (use_robot)
+    // the other measured distances had been added by the refinement
+    if (spec.refine_error > 0)
+        refine_measurements(points, measured_points.size() - grid_measured);
+
+    dataset->close();
+    delete dataset;
+    emit_event("end", "\"status\":\"ok\",\"distances\":" + to_string(points.size()));
+    return 0;
+}
+
+vector<statistics::RunningStats> make_measurements(SensorArray &sensors, int number_of_measurements, vector<ArraySample> &measurements, unsigned int delay_us)
+{
+    vector<statistics::RunningStats> stats(sensors.size());
+    vector<statistics::QuantileSketch> medians(sensors.size(), statistics::QuantileSketch(0.5));
+    for (int i = 0; i < number_of_measurements; i++)
+    {
+        ArraySample tick = sensors.sample();
+        measurements.push_back(tick);
+        // failed readings (-1) are kept in the csv but not in the statistics
+        for (size_t k = 0; k < tick.samples.size(); k++)
         {
-            cout << "Moving robot to position..." << endl;
+            if (tick.samples[k].distance_mm < 0)
+                continue;
+            stats[k].add(tick.samples[k].distance_mm);
+            medians[k].add(tick.samples[k].distance_mm);
+        }
 
-            if (current_measurement != min_measurement)
-                // if not first movement move robot by step size
-                robot_position[0] -= step_size;
-            else
-                // if first measurement move robot to starting position
-                robot_position[0] -= step_size > 0 ? min_measurement : max_measurement;
+        // with --precision, number_of_measurements is only the upper limit of a step
+        if (spec.precision > 0 && all_of(stats.begin(), stats.end(), [](const statistics::RunningStats &sensor_stats)
+                                         { return sensor_stats.count() >= ADAPTIVE_MIN_MEASUREMENTS &&
+                                                  sensor_stats.confidenceHalfWidth(PRECISION_CONFIDENCE) <= spec.precision; }))
+            break;
+        usleep(delay_us);
+    }
 
-            move_robot_to_position(robot_position);
+    for (size_t k = 0; k < sensors.size(); k++)
+    {
+        cout << left << setw(message_length) << sensors.getName(k) + ":" << stats[k].count() << " valid samples, mean "
+             << stats[k].mean() << " +- " << stats[k].confidenceHalfWidth(PRECISION_CONFIDENCE) << " mm, median " << medians[k].value() << " mm" << endl;
+    }
+    return stats;
+}
+
+vector<float> measure_step(float distance)
+{
+    vector<ArraySample> measurements; // vector storing all the measurements
+    string csv_file_name = "";        // name of output file
+    csv_file_name += (distance < 100 ? "0" : "");
+    csv_file_name += (distance < 10 ? "0" : "");
+    csv_file_name += to_string((int)distance) + "mm.csv";
+
+    cout << "Currently measuring: " << distance << " mm\n";
+    place_obstacle(distance);
+
+    cout << "Measuring distance..." << endl;
+    vector<statistics::RunningStats> stats = make_measurements(sensors, spec.samples, measurements, spec.delay_us);
+    cout << "Writing measurements to csv file\n\n";
+    // every sensor keeps its own folder for the analysis, the joined file aligns them tick by tick
+    for (size_t i = 0; i < sensors.size(); i++)
+        write_measurements_to_csv(measurements, i, "measurements/" + sensors.getName(i) + "/" + spec.surface + "/" + csv_file_name);
+    if (sensors.size() > 1)
+        write_joined_measurements_to_csv(measurements, "measurements/" + sensor_type + "/" + spec.surface + "/" + csv_file_name);
+    write_measurements_to_dataset(measurements, distance);
+
+    vector<float> means;
+    string sensor_means;
+    for (size_t i = 0; i < stats.size(); i++)
+    {
+        means.push_back(stats[i].count() > 0 ? stats[i].mean() : NAN);
+        stringstream mean_text;
+        mean_text << (stats[i].count() > 0 ? to_string(stats[i].mean()) : "null");
+        sensor_means += (i > 0 ? "," : "") + json_string(sensors.getName(i)) + ":{\"valid\":" + to_string(stats[i].count()) + ",\"mean\":" + mean_text.str() + "}";
+    }
+    emit_event("step", "\"distance\":" + to_string(distance) + ",\"sensors\":{" + sensor_means + "}");
+    return means;
+}
+
+float interpolation_error(const vector<CalibrationPoint> &points, size_t interval)
+{
+    // the linear interpolation between two points is off by up to |f''| h^2 / 8, with f'' estimated at both
+    // ends of the interval from the change of slope with the neighbouring intervals (i.e. where the reading saturates)
+    float h = points[interval + 1].distance - points[interval].distance;
+    float error = 0;
+    for (size_t k = 0; k < sensors.size(); k++)
+    {
+        for (size_t j = max(interval, (size_t)1); j <= interval + 1 && j + 1 < points.size(); j++)
+        {
+            const CalibrationPoint &previous = points[j - 1], &current = points[j], &next = points[j + 1];
+            float left_slope = (current.means[k] - previous.means[k]) / (current.distance - previous.distance);
+            float right_slope = (next.means[k] - current.means[k]) / (next.distance - current.distance);
+            float curvature = 2 * (right_slope - left_slope) / (next.distance - previous.distance);
+            if (!isnan(curvature))
+                error = max(error, fabs(curvature) * h * h / 8);
         }
-        else
+    }
+    return error;
+}
+
+void refine_measurements(vector<CalibrationPoint> &points, int added)
+{
+    sort(points.begin(), points.end(), [](const CalibrationPoint &a, const CalibrationPoint &b)
+         { return a.distance < b.distance; });
+
+    for (; added < REFINE_MAX_STEPS; added++)
+    {
+        // interval with the largest estimated error among those that can still be split
+        size_t worst = 0;
+        float worst_error = -1;
+        for (size_t i = 0; i + 1 < points.size(); i++)
         {
-            cout << "Please position the obstacle in front of the sensor" << endl
-                 << "Press enter to continue..." << endl;
-            getchar();
+            if (points[i + 1].distance - points[i].distance < 2 * REFINE_MIN_STEP_MM)
+                continue;
+            float error = interpolation_error(points, i);
+            if (error > worst_error)
+            {
+                worst = i;
+                worst_error = error;
+            }
+        }
+        if (worst_error < 0 || worst_error <= spec.refine_error)
+        {
+            cout << "Refinement complete after " << added << " added distances" << endl;
+            return;
         }
 
-        cout << "Measuring distance..." << endl;
-        make_measurements(*sensor, number_of_measurements, measurements, measurement_delay);
-        cout << "Writing measurements to csv file\n\n";
-        write_measurements_to_csv(measurements, file_path + csv_file_name);
-        current_measurement += step_size;
+        float distance = roundf((points[worst].distance + points[worst + 1].distance) / 2 / REFINE_MIN_STEP_MM) * REFINE_MIN_STEP_MM;
+        cout << "Refining between " << points[worst].distance << " mm and " << points[worst + 1].distance
+             << " mm, estimated interpolation error " << worst_error << " mm" << endl;
+        points.insert(points.begin() + worst + 1, {distance, measure_step(distance)});
     }
-    return 0;
+    cout << "Refinement stopped after " << REFINE_MAX_STEPS << " added distances" << endl;
+}
+void write_measurements_to_csv(const vector<ArraySample> &measurements, size_t sensor_index, string file_path)
+{
+    CsvLogger measurements_logger(file_path);
+    measurements_logger.write("distance\n");
+    for (const ArraySample &measurement : measurements)
+    {
+        measurements_logger << measurement.samples[sensor_index].distance_mm;
+        measurements_logger.end_row();
+    }
+
+    measurements_logger.close();
 }
 
-void make_measurements(DistanceSensor &sensor, int number_of_measurements, vector<float> &measurements, unsigned int delay_us)
+void write_joined_measurements_to_csv(const vector<ArraySample> &measurements, string file_path)
 {
-    float distance;
-    for (int i = 0; i < number_of_measurements; i++)
+    CsvLogger measurements_logger(file_path);
+    string header = "time,skew";
+    for (size_t i = 0; i < sensors.size(); i++)
     {
-        distance = sensor.getDistanceInMillimeters();
-        measurements.push_back(distance);
+        header += ',';
+        header += sensors.getName(i);
+    }
+    measurements_logger.write(header + "\n");
+    int64_t first_timestamp = measurements.empty() ? 0 : measurements.front().timestamp_ns;
+    for (const ArraySample &measurement : measurements)
+    {
+        // time from the first tick and spread of the samples of the tick in milliseconds
+        measurements_logger << (measurement.timestamp_ns - first_timestamp) / 1e+6;
+        measurements_logger << measurement.skew_ns / 1e+6;
+        for (const DistanceSample &sample : measurement.samples)
+            measurements_logger << sample.distance_mm;
+        measurements_logger.end_row();
+    }
+
+    measurements_logger.close();
+}
+
+void open_dataset(string file_path)
+{
+    vector<string> columns = {"time", "skew"};
+    for (size_t i = 0; i < sensors.size(); i++)
+        columns.push_back(sensors.getName(i));
+
+    try
+    {
+        dataset = new DatasetWriter(file_path, columns, spec.resume);
+    }
+    catch (const exception &e)
+    {
+        fail(e.what());
+    }
+
+    auto text = [](float value)
+    {
+        stringstream value_text;
+        value_text << value;
+        return value_text.str();
+    };
+    string position = "{";
+    for (size_t i = 0; i < spec.robot_position.size(); i++)
+        position += (i > 0 ? "," : "") + text(spec.robot_position[i]);
+    position += "}";
+    time_t start_time = time(nullptr);
+    char start_date[32];
+    strftime(start_date, sizeof(start_date), "%Y-%m-%dT%H:%M:%S", localtime(&start_time));
+
+    dataset->setMetadata("sensor", sensor_type);
+    dataset->setMetadata("surface", spec.surface);
+    dataset->setMetadata(resumed_run ? "resumed" : "date", start_date);
+    dataset->setMetadata("config_hash", spec_hash());
+    dataset->setMetadata("robot", spec.use_robot ? "meca500" : "manual");
+    dataset->setMetadata("robot_position", position);
+    dataset->setMetadata("options", "{" + text(spec.min_distance) + "," + text(spec.max_distance) + "," + text(spec.step) + "}");
+    dataset->setMetadata("measurements", to_string(spec.samples));
+    dataset->setMetadata("delay_us", to_string(spec.delay_us));
+    dataset->setMetadata("precision_mm", text(spec.precision));
+    dataset->setMetadata("refine_mm", text(spec.refine_error));
+    dataset->setMetadata("burst", to_string(spec.burst_pings));
+    dataset->setMetadata("gpio", spec.gpio_backend);
+    // a complete dataset without steps, so that a run stopped during the first step can be resumed
+    dataset->checkpoint();
+}
+
+void write_measurements_to_dataset(const vector<ArraySample> &measurements, float distance)
+{
+    // same columns of the joined csv: time and skew in milliseconds, then the distance of every sensor
+    dataset->beginStep(distance);
+    int64_t first_timestamp = measurements.empty() ? 0 : measurements.front().timestamp_ns;
+    for (const ArraySample &measurement : measurements)
+    {
+        *dataset << (measurement.timestamp_ns - first_timestamp) / 1e+6;
+        *dataset << measurement.skew_ns / 1e+6;
+        for (const DistanceSample &sample : measurement.samples)
+            *dataset << sample.distance_mm;
+        dataset->end_row();
+    }
+    // the step is on the disk before the next one starts, an interrupted run can be resumed from here
+    dataset->checkpoint();
+}
+
+void make_sweep_measurements(SensorArray &sensors, float velocity, vector<vector<StampedMeasurement>> &measurements, unsigned int delay_us)
+{
+    measurements.assign(sensors.size(), vector<StampedMeasurement>());
+    float start_distance = spec.step > 0 ? spec.min_distance : spec.max_distance;
+    float end_distance = spec.step > 0 ? spec.max_distance : spec.min_distance;
+    float origin_x = robot_position[0]; // robot x with the obstacle at zero distance
+    float end_x = origin_x - end_distance;
+
+    vector<float> start_position(robot_position);
+    start_position[0] = origin_x - start_distance;
+    cout << "Moving robot to starting position..." << endl;
+    move_robot_to_position(start_position);
+
+    // the pose is sampled by a separate thread at the EtherCAT cycle rate, each sample keeps the time of its frame
+    vector<StampedPose> poses;
+    atomic<bool> recording(true);
+    atomic<float> last_x(start_position[0]);
+    thread pose_recorder([&]()
+                         {
+        float pose[6];
+        int64_t timestamp, dc_time, last_timestamp = -1;
+        while (recording)
+        {
+            robot->get_pose_stamped(pose, timestamp, &dc_time);
+            if (timestamp != last_timestamp)
+            {
+                // the DC time is latched when the frame passes through the robot, more accurate than the receive time
+                poses.push_back({dc_clock.isSynchronised() ? dc_clock.toTimeline(dc_time) : timestamp, pose[0]});
+                last_timestamp = timestamp;
+                last_x = pose[0];
+            }
+            usleep(SWEEP_POSE_POLL_US);
+        } });
+
+    float direction = end_x < start_position[0] ? -1 : 1;
+    float velocity_command[6] = {direction * velocity, 0, 0, 0, 0, 0};
+    double timeout_s = fabs(end_distance - start_distance) / velocity + SWEEP_TIMEOUT_MARGIN_S;
+    int64_t deadline = timebase::now() + (int64_t)(timeout_s * 1e+9);
+
+    cout << "Measuring distance..." << endl;
+    robot->move_lin_vel_wrf(velocity_command);
+    while ((end_x - last_x) * direction > 0)
+    {
+        // every sample is located on the robot path with its own timestamp
+        ArraySample tick = sensors.sample();
+        for (size_t i = 0; i < tick.samples.size(); i++)
+            measurements[i].push_back({tick.samples[i].timestamp_ns, tick.samples[i].distance_mm, 0});
+
+        if (tick.timestamp_ns > deadline)
+        {
+            cerr << "Sweep timed out, robot stopped at x = " << last_x << endl;
+            break;
+        }
         usleep(delay_us);
     }
+    velocity_command[0] = 0;
+    robot->move_lin_vel_wrf(velocity_command);
+    recording = false;
+    pose_recorder.join();
+
+    for (vector<StampedMeasurement> &sensor_measurements : measurements)
+        interpolate_sweep_positions(sensor_measurements, poses, origin_x);
+}
+
+void interpolate_sweep_positions(vector<StampedMeasurement> &measurements, const vector<StampedPose> &poses, float origin_x)
+{
+    // measurements taken outside the recorded poses can't be located and are dropped
+    vector<StampedMeasurement> located;
+    located.reserve(measurements.size());
+
+    for (StampedMeasurement measurement : measurements)
+    {
+        auto next = lower_bound(poses.begin(), poses.end(), measurement.timestamp_ns,
+                                [](const StampedPose &pose, int64_t timestamp)
+                                { return pose.timestamp_ns < timestamp; });
+        if (next == poses.begin() || next == poses.end())
+            continue;
+        auto previous = next - 1;
+
+        double alpha = (double)(measurement.timestamp_ns - previous->timestamp_ns) / (next->timestamp_ns - previous->timestamp_ns);
+        float x = previous->x + alpha * (next->x - previous->x);
+        measurement.nominal = origin_x - x;
+        located.push_back(measurement);
+    }
+    measurements.swap(located);
 }
-void write_measurements_to_csv(vector<float> measurments, string file_path)
+
+void write_sweep_to_csv(const vector<StampedMeasurement> &measurements, string file_path)
 {
     CsvLogger measurements_logger(file_path);
-    measurements_logger.write("distance\n");
-    for (float measurement : measurments)
+    measurements_logger.write("time,nominal,distance\n");
+    int64_t first_timestamp = measurements.empty() ? 0 : measurements.front().timestamp_ns;
+    for (const StampedMeasurement &measurement : measurements)
     {
-        measurements_logger << measurement;
+        // time from the first measurement in milliseconds
+        measurements_logger << (measurement.timestamp_ns - first_timestamp) / 1e+6;
+        measurements_logger << measurement.nominal;
+        measurements_logger << measurement.distance;
         measurements_logger.end_row();
     }
 
     measurements_logger.close();
 }
 
+void recognise_surface()
+{
+    float reference = registry->getReferenceDistance();
+    cout << "Recognising the surface at " << reference << " mm" << endl;
+    place_obstacle(reference);
+
+    vector<ArraySample> measurements;
+    vector<statistics::RunningStats> stats = make_measurements(sensors, spec.samples, measurements, spec.delay_us);
+    for (size_t i = 0; i < sensors.size(); i++)
+    {
+        try
+        {
+            const SurfaceModel &model = registry->match(sensors.getName(i), stats[i].mean(), stats[i].variance());
+            sensors.getSensor(i).useCalibrationCurve(model.m, model.q);
+            cout << left << setw(message_length) << sensors.getName(i) + ":" << "surface " << model.surface
+                 << " (m " << model.m << ", q " << model.q << ")" << endl;
+            emit_event("recognised", "\"sensor\":" + json_string(sensors.getName(i)) + ",\"surface\":" + json_string(model.surface));
+        }
+        catch (const exception &e)
+        {
+            fail(e.what());
+        }
+    }
+    cout << endl;
+}
+
+void place_obstacle(float distance)
+{
+    if (spec.use_robot)
+    {
+        cout << "Moving robot to position..." << endl;
+        robot_position[0] = robot_origin_x - distance;
+        move_robot_to_position(robot_position);
+    }
+    else if (!spec.fixture.empty())
+    {
+        stringstream distance_text;
+        distance_text << distance;
+        run_fixture("distance", distance_text.str());
+    }
+    else
+    {
+        cout << "Please position the obstacle at " << distance << " mm from the sensor" << endl
+             << "Press enter to continue..." << endl;
+        getchar();
+    }
+}
+
+void run_fixture(const string &action, const string &argument)
+{
+    string command = spec.fixture + " " + action + " " + argument;
+    cout << "Running the fixture: " << command << endl;
+
+    // the fixture is a shell command, action and argument are passed as its arguments ("$@") and never parsed
+    // by the shell: the surface names come from unattended job files
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+        fail("Cannot run the fixture: " + string(strerror(errno)));
+    if (pid == 0)
+    {
+        string script = spec.fixture + " \"$@\"";
+        execl("/bin/sh", "sh", "-c", script.c_str(), "fixture", action.c_str(), argument.c_str(), (char *)nullptr);
+        perror("execl");
+        _exit(127);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        fail("The fixture failed: " + command);
+}
+
+void fail(const string &message)
+{
+    cerr << message << endl
+         << "Program will now exit..." << endl;
+    emit_event("error", "\"message\":" + json_string(message));
+    exit(1);
+}
+
+string json_string(const string &text)
+{
+    stringstream json;
+    json << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            json << '\\' << c;
+        else if ((unsigned char)c < 0x20)
+            json << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+        else
+            json << c;
+    }
+    json << '"';
+    return json.str();
+}
+
+void emit_event(const string &name, const string &fields)
+{
+    if (events_file == nullptr)
+        return;
+    // one write per line, so that the events of the jobs of a batch don't mix
+    double time_s = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+    stringstream line;
+    line << fixed << setprecision(3) << "{\"time\":" << time_s << ",\"event\":" << json_string(name)
+         << (fields.empty() ? "" : ",") << fields << "}\n";
+    fputs(line.str().c_str(), events_file);
+    fflush(events_file);
+}
+
 void move_robot_to_position(vector<float> robot_position)
 {
     robot->move_pose(
@@ -227,14 +817,246 @@ void move_robot_to_position(vector<float> robot_position)
 
 void initialise_robot()
 {
-    use_robot = true;
     robot = new Robot(-30, 230, 5000, "eth0", 0.0, 10);
     robot->reset_error();
     robot->set_conf(1, 1, -1);
+    robot->on_exchange([](int64_t timestamp_ns, int64_t dc_time_ns)
+                       { dc_clock.addSample(dc_time_ns, timestamp_ns); });
     // robot->print_pose();
     move_robot_to_position(robot_position);
 }
 
+int run_batch(int argc, char *argv[])
+{
+    vector<vector<string>> jobs;
+    try
+    {
+        jobs = parse_job_file(spec.batch);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl
+             << "Program will now exit..." << endl;
+        return 1;
+    }
+
+    // the options of the command line are common to every job, those of the job come after them and win
+    vector<string> common;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.rfind("--" BATCH_COMMAND, 0) != 0 && arg.rfind("--" EVENTS_COMMAND, 0) != 0 && arg != "--" DRY_RUN_COMMAND)
+            common.push_back(arg);
+    }
+    auto option_value = [](const vector<string> &arguments, const string &name)
+    {
+        string value = "";
+        for (const string &argument : arguments)
+        {
+            if (argument.rfind("--" + name + "=", 0) == 0)
+                value = argument.substr(name.size() + 3);
+        }
+        return value;
+    };
+
+    // every job is checked with a dry run before the first one starts, so a typo doesn't stop the batch at night
+    cout << "Checking " << jobs.size() << " jobs\n\n";
+    emit_event("batch_start", "\"jobs\":" + to_string(jobs.size()));
+    double total = 0;
+    int invalid = 0;
+    string previous_surface;
+    for (size_t job = 0; job < jobs.size(); job++)
+    {
+        jobs[job].insert(jobs[job].begin(), common.begin(), common.end());
+        vector<string> check = jobs[job];
+        check.push_back("--" DRY_RUN_COMMAND);
+        double estimate_s = 0;
+        if (run_job(check, job + 1, &estimate_s) != 0)
+        {
+            cerr << "Job " << job + 1 << " is invalid" << endl;
+            invalid++;
+        }
+        total += estimate_s;
+
+        // nobody is there to change the surface between two jobs
+        string surface = option_value(jobs[job], SURFACE_TYPE_COMMAND);
+        if (job > 0 && surface != previous_surface && option_value(jobs[job], FIXTURE_COMMAND).empty())
+        {
+            cerr << "Job " << job + 1 << " changes the surface to " << surface << " without a --" FIXTURE_COMMAND << endl;
+            invalid++;
+        }
+        previous_surface = surface;
+    }
+    if (invalid > 0)
+    {
+        emit_event("batch_end", "\"status\":\"invalid\",\"invalid\":" + to_string(invalid));
+        cerr << invalid << " invalid jobs" << endl
+             << "Program will now exit..." << endl;
+        return 1;
+    }
+    cout << left << setw(message_length) << "Batch duration:" << format_duration(total) << " for " << jobs.size() << " jobs\n\n";
+    emit_event("batch_plan", "\"jobs\":" + to_string(jobs.size()) + ",\"estimate_s\":" + to_string(total));
+    if (spec.dry_run)
+        return 0;
+
+    // a failed job doesn't stop the others, the batch can be run again with --resume
+    int failed = 0;
+    for (size_t job = 0; job < jobs.size(); job++)
+    {
+        cout << "Starting job " << job + 1 << " of " << jobs.size() << "\n\n";
+        if (run_job(jobs[job], job + 1, nullptr) != 0)
+        {
+            cerr << "Job " << job + 1 << " failed" << endl;
+            failed++;
+        }
+    }
+    emit_event("batch_end", "\"status\":" + json_string(failed > 0 ? "failed" : "ok") + ",\"jobs\":" + to_string(jobs.size()) +
+                                ",\"failed\":" + to_string(failed));
+    cout << jobs.size() - failed << " of " << jobs.size() << " jobs completed" << endl;
+    return failed > 0 ? 1 : 0;
+}
+
+vector<vector<string>> parse_job_file(const string &job_file_path)
+{
+    ifstream job_file(job_file_path);
+    if (!job_file.is_open())
+        throw runtime_error("Cannot open the job list " + job_file_path);
+
+    vector<vector<string>> jobs;
+    string row;
+    int line_number = 0;
+    while (getline(job_file, row))
+    {
+        line_number++;
+        string where = job_file_path + ":" + to_string(line_number) + ": ";
+        // options separated by spaces as on the command line (the -- is optional), double quotes keep the spaces of a value
+        vector<string> arguments;
+        string token;
+        bool quoted = false, in_token = false;
+        for (char c : row)
+        {
+            if (c == '"')
+            {
+                quoted = !quoted;
+                in_token = true;
+            }
+            else if (!quoted && c == '#')
+                break;
+            else if (!quoted && isspace((unsigned char)c))
+            {
+                if (in_token)
+                    arguments.push_back(token);
+                token.clear();
+                in_token = false;
+            }
+            else
+            {
+                token += c;
+                in_token = true;
+            }
+        }
+        if (quoted)
+            throw runtime_error(where + "unterminated quote");
+        if (in_token)
+            arguments.push_back(token);
+
+        for (string &argument : arguments)
+        {
+            if (argument.rfind("--", 0) == 0)
+                argument = argument.substr(2);
+            string name = argument.substr(0, argument.find('='));
+            if (!optionHandlers.count(name) || name == BATCH_COMMAND || name == EVENTS_COMMAND)
+                throw runtime_error(where + "invalid option " + name);
+            argument = "--" + argument;
+        }
+        if (!arguments.empty())
+            jobs.push_back(arguments);
+    }
+    if (jobs.empty())
+        throw runtime_error("No jobs in " + job_file_path);
+    return jobs;
+}
+
+int run_job(const vector<string> &arguments, int job, double *estimate_s)
+{
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    // the job is the same program, headless, writing its events on a pipe read here
+    vector<string> job_arguments = arguments;
+    job_arguments.push_back("--" HEADLESS_COMMAND);
+    job_arguments.push_back("--" EVENTS_COMMAND "=/dev/fd/" + to_string(JOB_EVENTS_FD));
+    if (estimate_s == nullptr)
+    {
+        string arguments_json;
+        for (size_t i = 0; i < arguments.size(); i++)
+            arguments_json += (i > 0 ? "," : "") + json_string(arguments[i]);
+        emit_event("job_start", "\"job\":" + to_string(job) + ",\"arguments\":[" + arguments_json + "]");
+    }
+
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // no stdin: a prompt left somewhere reads the end of file instead of blocking the batch
+        int null_fd = open("/dev/null", O_RDONLY);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(pipe_fds[1], JOB_EVENTS_FD);
+        if (pipe_fds[0] != JOB_EVENTS_FD)
+            close(pipe_fds[0]);
+        if (pipe_fds[1] != JOB_EVENTS_FD)
+            close(pipe_fds[1]);
+
+        vector<char *> job_argv = {(char *)"calibrazione"};
+        for (const string &argument : job_arguments)
+            job_argv.push_back((char *)argument.c_str());
+        job_argv.push_back(nullptr);
+        execv("/proc/self/exe", job_argv.data());
+        perror("execv");
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+    FILE *job_events = fdopen(pipe_fds[0], "r");
+    char *line = nullptr;
+    size_t length = 0;
+    while (getline(&line, &length, job_events) > 0)
+    {
+        string event(line);
+        // the estimate of a dry run is in its plan
+        size_t estimate = event.find("\"estimate_s\":");
+        if (estimate_s != nullptr && event.find("\"event\":\"plan\"") != string::npos && estimate != string::npos)
+            *estimate_s = strtod(event.c_str() + estimate + strlen("\"estimate_s\":"), nullptr);
+        if (events_file != nullptr && event[0] == '{')
+        {
+            event.insert(1, "\"job\":" + to_string(job) + ",");
+            fputs(event.c_str(), events_file);
+            fflush(events_file);
+        }
+    }
+    free(line);
+    fclose(job_events);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (estimate_s == nullptr)
+        emit_event("job_end", "\"job\":" + to_string(job) + ",\"status\":" + json_string(exit_code == 0 ? "ok" : "failed") +
+                                  ",\"exit_code\":" + to_string(exit_code));
+    return exit_code;
+}
+
 void display_usage()
 {
     cout << left << setw(optionWidth) << "Usage: ./calibrazione [OPTIONS]" << endl
@@ -285,8 +1107,8 @@ void setup_help_messages()
     sensorMessage
         << left
         << "  --" << SENSOR_COMMAND << setw(optionWidth - strlen(SENSOR_COMMAND))
-        << "=TYPE"
-        << "Specify sensor type (e.g., infrared, ultrasonic)" << endl;
+        << "=TYPE[,TYPE]"
+        << "Specify sensor type (e.g., infrared, ultrasonic), comma separated to measure with both at once" << endl;
 
     surfaceMessage
         << left
@@ -301,8 +1123,86 @@ void setup_help_messages()
     calibrationMessage
         << left
         << "  --" << CALIBRATION_COMMAND << setw(optionWidth - strlen(CALIBRATION_COMMAND))
-        << "=\"{m, q}\""
-        << "Specify the calibration parameters of the sensor [default {1, 0} ]" << endl;
+        << "=\"{m, q}\"|SURFACE|" CALIBRATION_AUTO_VALUE
+        << "Specify the calibration parameters of the sensor [default {1, 0} ], or a surface of the --registry (" CALIBRATION_AUTO_VALUE " recognises it)" << endl;
+
+    sweepMessage
+        << left
+        << "  --" << SWEEP_COMMAND << setw(optionWidth - strlen(SWEEP_COMMAND))
+        << "=VELOCITY_MM_S"
+        << "Measure continuously while the robot moves at constant velocity (requires --userobot)" << endl;
+
+    gpioMessage
+        << left
+        << "  --" << GPIO_COMMAND << setw(optionWidth - strlen(GPIO_COMMAND))
+        << "=BACKEND"
+        << "GPIO backend of the ultrasonic sensor: pigpio, gpiod[:/dev/gpiochipN], simulated[:PROFILE[@NOISE]]" << endl;
+
+    burstMessage
+        << left
+        << "  --" << BURST_COMMAND << setw(optionWidth - strlen(BURST_COMMAND))
+        << "=PINGS"
+        << "Ultrasonic only: every measurement is the outlier-free mean of a burst of pings" << endl;
+
+    precisionMessage
+        << left
+        << "  --" << PRECISION_COMMAND << setw(optionWidth - strlen(PRECISION_COMMAND))
+        << "=MM"
+        << "Stop each step when the 95% confidence interval on the mean is within +-MM, --measurements becomes the maximum" << endl;
+
+    refineMessage
+        << left
+        << "  --" << REFINE_COMMAND << setw(optionWidth - strlen(REFINE_COMMAND))
+        << "=MM"
+        << "After the --options grid, add distances where the curve bends until the interpolation error is below MM" << endl;
+
+    registryMessage
+        << left
+        << "  --" << REGISTRY_COMMAND << setw(optionWidth - strlen(REGISTRY_COMMAND))
+        << "=FILE"
+        << "Calibration registry written by analisi, used by --" CALIBRATION_COMMAND "=SURFACE" << endl;
+
+    dryRunMessage
+        << left
+        << "  --" << setw(optionWidth) << DRY_RUN_COMMAND << setw(descriptionWidth) << "Check the options and print the plan and the estimated duration of the run, without measuring" << endl;
+
+    robotLimitsMessage
+        << left
+        << "  --" << ROBOT_LIMITS_COMMAND << setw(optionWidth - strlen(ROBOT_LIMITS_COMMAND))
+        << "=\"{MM_S, MM_S2}\""
+        << "Velocity and acceleration of the robot used by the estimate [default {" << ROBOT_VELOCITY_DEFAULT << ", " << ROBOT_ACCELERATION_DEFAULT << "} ]" << endl;
+
+    resumeMessage
+        << left
+        << "  --" << setw(optionWidth) << RESUME_COMMAND << setw(descriptionWidth) << "Continue an interrupted run with the same options, skipping the distances already in its dataset" << endl;
+
+    portMessage
+        << left
+        << "  --" << PORT_COMMAND << setw(optionWidth - strlen(PORT_COMMAND))
+        << "=PATH"
+        << "Serial port of the infrared sensor [default: ask the user, the first sensor found with --" HEADLESS_COMMAND "]" << endl;
+
+    headlessMessage
+        << left
+        << "  --" << setw(optionWidth) << HEADLESS_COMMAND << setw(descriptionWidth) << "Never wait for the user: the robot or the --" FIXTURE_COMMAND " place the obstacle" << endl;
+
+    fixtureMessage
+        << left
+        << "  --" << FIXTURE_COMMAND << setw(optionWidth - strlen(FIXTURE_COMMAND))
+        << "=\"COMMAND\""
+        << "Run \"COMMAND surface NAME\" before measuring and, without the robot, \"COMMAND distance MM\" at every step" << endl;
+
+    eventsMessage
+        << left
+        << "  --" << EVENTS_COMMAND << setw(optionWidth - strlen(EVENTS_COMMAND))
+        << "=FILE"
+        << "Append the progress of the run to FILE, one JSON object per line" << endl;
+
+    batchMessage
+        << left
+        << "  --" << BATCH_COMMAND << setw(optionWidth - strlen(BATCH_COMMAND))
+        << "=FILE"
+        << "Run the jobs of FILE (one line of options each) headless, the other options are common to all of them" << endl;
 }
 
 void setup_handlers()
@@ -317,34 +1217,351 @@ void setup_handlers()
     optionHandlers[SURFACE_TYPE_COMMAND] = OptionHandler(handleSurface, surfaceMessage.str());
     optionHandlers[USE_ROBOT_COMMAND] = OptionHandler(handleRobot, robotMessage.str());
     optionHandlers[CALIBRATION_COMMAND] = OptionHandler(handleCalibration, calibrationMessage.str());
+    optionHandlers[SWEEP_COMMAND] = OptionHandler(handleSweep, sweepMessage.str());
+    optionHandlers[GPIO_COMMAND] = OptionHandler(handleGpio, gpioMessage.str());
+    optionHandlers[BURST_COMMAND] = OptionHandler(handleBurst, burstMessage.str());
+    optionHandlers[PRECISION_COMMAND] = OptionHandler(handlePrecision, precisionMessage.str());
+    optionHandlers[REFINE_COMMAND] = OptionHandler(handleRefine, refineMessage.str());
+    optionHandlers[REGISTRY_COMMAND] = OptionHandler(handleRegistry, registryMessage.str());
+    optionHandlers[DRY_RUN_COMMAND] = OptionHandler(handleDryRun, dryRunMessage.str());
+    optionHandlers[ROBOT_LIMITS_COMMAND] = OptionHandler(handleRobotLimits, robotLimitsMessage.str());
+    optionHandlers[RESUME_COMMAND] = OptionHandler(handleResume, resumeMessage.str());
+    optionHandlers[PORT_COMMAND] = OptionHandler(handlePort, portMessage.str());
+    optionHandlers[HEADLESS_COMMAND] = OptionHandler(handleHeadless, headlessMessage.str());
+    optionHandlers[FIXTURE_COMMAND] = OptionHandler(handleFixture, fixtureMessage.str());
+    optionHandlers[EVENTS_COMMAND] = OptionHandler(handleEvents, eventsMessage.str());
+    optionHandlers[BATCH_COMMAND] = OptionHandler(handleBatch, batchMessage.str());
 }
 
 int setup_options(map<string, string> options)
 {
+    // the handlers only fill the specification, so every invalid option is reported and not only the first one.
+    // --events is opened first: the errors of the other options are events too (the only output of a headless job)
+    vector<pair<string, string>> ordered_options;
+    if (options.count(EVENTS_COMMAND))
+        ordered_options.push_back({EVENTS_COMMAND, options[EVENTS_COMMAND]});
     for (auto option : options)
+    {
+        if (option.first != EVENTS_COMMAND)
+            ordered_options.push_back(option);
+    }
+
+    int errors = 0;
+    for (auto option : ordered_options)
     {
         string optionName = option.first;
         string value = option.second;
         if (optionHandlers.count(optionName))
         {
-            cout << optionHandlers[optionName].handler(value) << endl;
+            try
+            {
+                cout << optionHandlers[optionName].handler(value) << endl;
+            }
+            catch (const exception &e)
+            {
+                cerr << "--" << optionName << ": " << e.what() << endl;
+                emit_event("error", "\"message\":" + json_string("--" + optionName + ": " + e.what()));
+                errors++;
+            }
         }
         else
         {
-            handleNotFound(optionName);
+            // a typo would otherwise run the whole calibration without the intended option
+            cerr << handleNotFound("--" + optionName);
+            emit_event("error", "\"message\":" + json_string("Unknown command: --" + optionName));
+            errors++;
         }
     }
+    return errors;
+}
 
-    if (sensor == nullptr)
+bool validate_spec()
+{
+    vector<string> errors;
+    if (spec.sensors.empty())
+        errors.push_back("Sensor type not set, please specify it with --" SENSOR_COMMAND "=[infrared, ultrasonic]");
+    else
     {
-        cerr << "Sensor type not set!!" << endl
-             << "Please specify the sensor type with" << endl
-             << "--" << SENSOR_COMMAND << "=[infrared, ultrasonic]" << endl
-             << "Program will now exit..." << endl;
-        return 1;
+        sensor_type = spec.sensors[0];
+        for (size_t i = 1; i < spec.sensors.size(); i++)
+            sensor_type += "+" + spec.sensors[i];
+        dataset_path = "measurements/" + sensor_type + "/" + spec.surface + ".caldata";
+    }
+    if (spec.min_distance >= spec.max_distance)
+        errors.push_back("min_measurement can't be higher or equal to max_measurement (--" MEASUREMENTS_OPTIONS_COMMAND ")");
+    if (spec.step == 0)
+        errors.push_back("step_size can't be 0 (--" MEASUREMENTS_OPTIONS_COMMAND ")");
+    if (spec.sweep_velocity > 0 && !spec.use_robot)
+        errors.push_back("Sweep measurements need the robot, please enable it with --" USE_ROBOT_COMMAND);
+    if (spec.sweep_velocity > spec.robot_velocity)
+        errors.push_back("The sweep velocity is higher than the velocity of the robot (--" ROBOT_LIMITS_COMMAND ")");
+    if (spec.burst_pings > 0 && find(spec.sensors.begin(), spec.sensors.end(), ULTRASONIC_SENSOR_VALUE) == spec.sensors.end())
+        errors.push_back("Bursts of pings are available only for the ultrasonic sensor");
+    if (!spec.calibration_surface.empty() && spec.registry.empty())
+        errors.push_back("Calibrating by surface needs the registry, please load it with --" REGISTRY_COMMAND);
+    if (spec.headless && !spec.use_robot && spec.fixture.empty())
+        errors.push_back("A headless run needs the robot (--" USE_ROBOT_COMMAND ") or a --" FIXTURE_COMMAND " to place the obstacle");
+    if (!spec.port.empty() && find(spec.sensors.begin(), spec.sensors.end(), INFRARED_SENSOR_VALUE) == spec.sensors.end())
+        errors.push_back("--" PORT_COMMAND " selects the infrared sensor, which isn't used");
+
+    // the registry is only a file: it is read now so that a missing surface doesn't stop the run halfway
+    if (!spec.registry.empty())
+    {
+        try
+        {
+            registry = new CalibrationRegistry(spec.registry);
+        }
+        catch (const exception &e)
+        {
+            errors.push_back(e.what());
+        }
+    }
+    if (registry != nullptr && !spec.calibration_surface.empty())
+    {
+        for (const string &sensor : spec.sensors)
+        {
+            const vector<SurfaceModel> &models = registry->getModels();
+            if (spec.calibration_surface != CALIBRATION_AUTO_VALUE)
+            {
+                try
+                {
+                    registry->find(sensor, spec.calibration_surface);
+                }
+                catch (const out_of_range &e)
+                {
+                    errors.push_back(e.what());
+                }
+            }
+            else if (none_of(models.begin(), models.end(), [&](const SurfaceModel &model)
+                             { return model.sensor == sensor && model.reference_count > 0; }))
+                errors.push_back("No surface with a signature for " + sensor + " in the registry");
+        }
     }
 
-    return 0;
+    // a resumed run continues the same measurements: the options must give the same hash stored in its dataset
+    if (spec.resume && spec.sweep_velocity > 0)
+        errors.push_back("A sweep is a single movement and can't be resumed");
+    else if (spec.resume && !spec.sensors.empty() && DatasetWriter::isPlaceholder(dataset_path))
+        cout << "The run in " << dataset_path << " stopped before its first step, it starts again\n\n";
+    else if (spec.resume && !spec.sensors.empty() && ifstream(dataset_path).good())
+    {
+        try
+        {
+            DatasetReader run(dataset_path);
+            string run_hash = run.metadata("config_hash", "");
+            if (run_hash != spec_hash())
+                throw runtime_error("The run in " + dataset_path + " was measured with different options, it can't be resumed");
+            for (size_t step = 0; step < run.steps(); step++)
+            {
+                CalibrationPoint point = {(float)run.stepKey(step), {}};
+                for (const string &sensor : spec.sensors)
+                {
+                    // failed readings (-1) are not in the mean, as in make_measurements
+                    const double *values = run.values(step, run.column(sensor));
+                    statistics::RunningStats sensor_stats;
+                    for (size_t row = 0; row < run.rows(step); row++)
+                        if (values[row] >= 0)
+                            sensor_stats.add(values[row]);
+                    point.means.push_back(sensor_stats.count() > 0 ? sensor_stats.mean() : NAN);
+                }
+                measured_points.push_back(point);
+            }
+            resumed_run = true;
+        }
+        catch (const exception &e)
+        {
+            errors.push_back(e.what());
+        }
+    }
+
+    for (const string &error : errors)
+    {
+        cerr << error << endl;
+        emit_event("error", "\"message\":" + json_string(error));
+    }
+    return errors.empty();
+}
+
+string spec_hash()
+{
+    // FNV-1a of the options written in text, the motion limits and the robot usage don't change the measurements
+    stringstream options;
+    options << setprecision(9) << sensor_type << ";" << spec.surface << ";" << spec.min_distance << ";" << spec.max_distance << ";"
+            << spec.step << ";" << spec.refine_error << ";" << spec.samples << ";" << spec.precision << ";" << spec.delay_us << ";"
+            << spec.burst_pings << ";" << spec.gpio_backend << ";" << spec.calibration_surface << ";";
+    for (float value : spec.robot_position)
+        options << value << ",";
+    for (float value : spec.calibration_line)
+        options << value << ",";
+
+    uint64_t hash = 1469598103934665603ULL;
+    for (char c : options.str())
+        hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+    stringstream hash_text;
+    hash_text << hex << setw(16) << setfill('0') << hash;
+    return hash_text.str();
+}
+
+bool measured(float distance)
+{
+    return any_of(measured_points.begin(), measured_points.end(), [distance](const CalibrationPoint &point)
+                  { return point.distance == distance; });
+}
+
+void setup_run()
+{
+    cout << "Initialising " << sensor_type << " sensor" << endl;
+    for (const string &type : spec.sensors)
+    {
+        if (type == INFRARED_SENSOR_VALUE)
+        {
+            // headless runs take the first sensor found instead of asking
+            if (!spec.port.empty())
+                sensors.addSensor(new InfraredSensor(spec.port), type);
+            else
+                sensors.addSensor(new InfraredSensor(spec.headless ? InfraredSensor::ENABLE_ALL : InfraredSensor::USER_INPUT), type);
+            // sensor->useCalibrationCurve(1.0,13.01);
+        }
+        else
+        {
+            try
+            {
+                sensors.addSensor(new UltrasonicSensor(TRIG_PIN, ECHO_PIN, GpioBackend::create(spec.gpio_backend)), type,
+                                  [](DistanceSensor &sensor)
+                                  {
+                                      if (spec.burst_pings == 0)
+                                          return sensor.sampleInMillimeters();
+                                      BurstEstimate estimate = static_cast<UltrasonicSensor &>(sensor).burst(spec.burst_pings);
+                                      return DistanceSample{estimate.timestamp_ns, estimate.distance_mm};
+                                  });
+            }
+            catch (const exception &e)
+            {
+                fail(e.what());
+            }
+        }
+    }
+
+    robot_position = spec.robot_position;
+    if (spec.use_robot)
+    {
+        cout << "Initialising robot EtherCAT interface" << endl;
+        initialise_robot();
+    }
+
+    // the surfaces have been checked by validate_spec, the automatic one is recognised before measuring
+    for (size_t i = 0; i < sensors.size(); i++)
+    {
+        if (!spec.calibration_line.empty())
+            sensors.getSensor(i).useCalibrationCurve(spec.calibration_line[0], spec.calibration_line[1]);
+        else if (!spec.calibration_surface.empty() && spec.calibration_surface != CALIBRATION_AUTO_VALUE)
+        {
+            const SurfaceModel &model = registry->find(sensors.getName(i), spec.calibration_surface);
+            sensors.getSensor(i).useCalibrationCurve(model.m, model.q);
+            cout << left << setw(message_length) << "Calibration: " << sensors.getName(i) << " on " << model.surface
+                 << " (m " << model.m << ", q " << model.q << ")" << endl;
+        }
+    }
+}
+
+double move_time(float distance)
+{
+    // trapezoidal velocity profile, triangular when the distance is too short to reach the velocity
+    double velocity = spec.robot_velocity, acceleration = spec.robot_acceleration;
+    double motion = distance < velocity * velocity / acceleration ? 2 * sqrt(distance / acceleration)
+                                                                   : distance / velocity + velocity / acceleration;
+    // Robot::move_pose returns at the first check after the end of the movement
+    return MOVE_POLL_DELAY_S + ceil(max(0.0, motion - MOVE_POLL_DELAY_S) / MOVE_POLL_PERIOD_S) * MOVE_POLL_PERIOD_S;
+}
+
+double sample_time()
+{
+    // the sensors of the array are triggered together, the slowest one sets the tick
+    double sensor_us = 0;
+    for (const string &type : spec.sensors)
+    {
+        if (type == INFRARED_SENSOR_VALUE)
+            sensor_us = max(sensor_us, (double)INFRARED_SAMPLE_US);
+        else if (spec.burst_pings > 0) // same period of UltrasonicSensor::burstPeriodUs
+            sensor_us = max(sensor_us, spec.burst_pings * (TRIGGER_WIDTH + MAX_SENSOR_DELAY + 2.0 * MAX_SENSOR_DISTANCE_CM * US_ROUNDTRIP_CM));
+        else // a ping without echo waits for the farthest distance
+            sensor_us = max(sensor_us, TRIGGER_WIDTH + MAX_SENSOR_DELAY + (double)MAX_SENSOR_DISTANCE_CM * US_ROUNDTRIP_CM);
+    }
+    return (sensor_us + spec.delay_us) / 1e+6;
+}
+
+string format_duration(double seconds)
+{
+    stringstream duration_text;
+    int total = (int)ceil(seconds);
+    if (total >= 3600)
+        duration_text << total / 3600 << " h ";
+    if (total >= 60)
+        duration_text << total / 60 % 60 << " min ";
+    duration_text << total % 60 << " s";
+    return duration_text.str();
+}
+
+void print_estimate()
+{
+    float start_distance = spec.step > 0 ? spec.min_distance : spec.max_distance;
+    float end_distance = spec.step > 0 ? spec.max_distance : spec.min_distance;
+    double range = spec.max_distance - spec.min_distance;
+    double tick = sample_time();
+    double step_time = spec.samples * tick; // the most a step takes, --precision can stop it earlier
+    double total = 0;
+
+    cout << left << "Run plan:\n"
+         << setw(message_length) << "Sensors:" << sensor_type << "\n"
+         << setw(message_length) << "Sample period:" << tick * 1e+3 << " ms at most\n";
+
+    if (spec.calibration_surface == CALIBRATION_AUTO_VALUE)
+    {
+        total += step_time + (spec.use_robot ? move_time(registry->getReferenceDistance()) : 0);
+        cout << setw(message_length) << "Surface recognition:" << "at " << registry->getReferenceDistance() << " mm\n";
+    }
+
+    if (spec.sweep_velocity > 0)
+    {
+        double sweep = range / spec.sweep_velocity + spec.sweep_velocity / spec.robot_acceleration;
+        total += move_time(start_distance) + sweep;
+        cout << setw(message_length) << "Sweep:" << "from " << start_distance << " mm to " << end_distance << " mm at "
+             << spec.sweep_velocity << " mm/s, about " << (long)(sweep / tick) << " samples per sensor\n";
+    }
+    else
+    {
+        int steps = 0, remaining = 0;
+        for (float distance = start_distance; distance <= spec.max_distance && distance >= spec.min_distance; distance += spec.step)
+        {
+            steps++;
+            remaining += measured(distance) ? 0 : 1;
+        }
+        total += remaining * step_time;
+        if (spec.use_robot && remaining > 0)
+            total += move_time(start_distance) + (remaining - 1) * move_time(fabs(spec.step));
+        cout << setw(message_length) << "Distances:" << steps << " from " << start_distance << " mm to " << end_distance << " mm, step " << spec.step << " mm\n";
+        if (resumed_run)
+            cout << setw(message_length) << "Already measured:" << measured_points.size() << " distances, " << remaining << " left on the grid\n";
+        cout << setw(message_length) << "Samples per distance:" << spec.samples;
+        if (spec.precision > 0)
+            cout << " at most, at least " << ADAPTIVE_MIN_MEASUREMENTS << " (stops at +-" << spec.precision << " mm)";
+        cout << "\n";
+    }
+
+    cout << setw(message_length) << "Estimated duration:" << format_duration(total);
+    if (spec.refine_error > 0 && spec.sweep_velocity <= 0)
+    {
+        // every added distance can be anywhere in the range
+        int refine_steps = max(0, REFINE_MAX_STEPS - (int)measured_points.size());
+        double refine = refine_steps * (step_time + (spec.use_robot ? move_time(range) : 0));
+        cout << ", up to " << format_duration(total + refine) << " with the refinement (" << REFINE_MAX_STEPS << " distances at most)";
+    }
+    if (!spec.use_robot && spec.fixture.empty())
+        cout << ", plus placing the obstacle by hand at every distance";
+    cout << "\n"
+         << endl;
+    emit_event("plan", "\"sensor\":" + json_string(sensor_type) + ",\"surface\":" + json_string(spec.surface) +
+                           ",\"estimate_s\":" + to_string(total) + ",\"dry_run\":" + (spec.dry_run ? "true" : "false"));
 }
 
 map<string, string> parse_command_line(int argc, char *argv[])
@@ -376,11 +1593,7 @@ map<string, string> parse_config_file(string config_file_path)
     map<string, string> options;
     ifstream config_file(config_file_path);
     if (!config_file.is_open())
-    {
-        cerr << "Error opening config file!" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1); // Return an error code
-    }
+        throw runtime_error("Cannot open the config file " + config_file_path);
     string config_row;
 
     while (getline(config_file, config_row))
@@ -428,6 +1641,23 @@ vector<float> parse_string_to_vector(string input)
     return result;
 }
 
+double parse_number(string input)
+{
+    size_t parsed = 0;
+    double value = 0;
+    try
+    {
+        value = stod(input, &parsed);
+    }
+    catch (const exception &e)
+    {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != input.size())
+        throw invalid_argument("\"" + input + "\" is not a number");
+    return value;
+}
+
 string handleHelp(string value)
 {
     display_usage();
@@ -440,25 +1670,14 @@ string handleMeasurementsOption(string value)
     stringstream option_message;
     vector<float> measurement_options = parse_string_to_vector(value);
     if (measurement_options.size() < 3)
-    {
-        cerr << "Invalid measurement options, not enough arguments" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
-    if (measurement_options[0] >= measurement_options[1])
-    {
-        cerr << "Invalid measurement options, min_measurement can't be higher or equal to max_measurement" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
-    min_measurement = measurement_options[0];
-    max_measurement = measurement_options[1];
-    step_size = measurement_options[2];
-    current_measurement = step_size > 0 ? min_measurement : max_measurement;
+        throw invalid_argument("Invalid measurement options, not enough arguments");
+    spec.min_distance = measurement_options[0];
+    spec.max_distance = measurement_options[1];
+    spec.step = measurement_options[2];
     option_message << left << "Measurement options:\n"
-                   << setw(message_length) << "Minimum measurement:" << min_measurement << endl
-                   << setw(message_length) << "Maximum measurement:" << max_measurement << endl
-                   << setw(message_length) << "Step size:" << step_size << endl;
+                   << setw(message_length) << "Minimum measurement:" << spec.min_distance << endl
+                   << setw(message_length) << "Maximum measurement:" << spec.max_distance << endl
+                   << setw(message_length) << "Step size:" << spec.step << endl;
     return option_message.str();
 }
 
@@ -467,105 +1686,234 @@ string handleRobotStartingPosition(string value)
     stringstream option_message;
     vector<float> robot_position_values = parse_string_to_vector(value);
     if (robot_position_values.size() < 6)
-    {
-        cerr << "Invalid robot position, not enough arguments" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
+        throw invalid_argument("Invalid robot position, not enough arguments");
     option_message << left << setw(message_length) << "Starting robot position: {";
     for (float pos : robot_position_values)
         option_message << pos << ", ";
     option_message << "}" << endl;
-    robot_position = robot_position_values;
+    spec.robot_position = robot_position_values;
     return option_message.str();
 }
 
 string handleSensor(string value)
 {
-    cout << left << setw(message_length) << "Sensor used: " << value << "\nInitalising sensor" << endl;
-
-    if (value == INFRARED_SENSOR_VALUE)
+    stringstream option_message;
+    stringstream types(value);
+    string type;
+    vector<string> names;
+    while (getline(types, type, ','))
     {
-        sensor = new InfraredSensor(InfraredSensor::USER_INPUT);
-        // sensor->useCalibrationCurve(1.0,13.01);
+        if (find(names.begin(), names.end(), type) != names.end())
+            throw invalid_argument("Sensor " + type + " specified twice");
+        if (type != INFRARED_SENSOR_VALUE && type != ULTRASONIC_SENSOR_VALUE)
+            throw invalid_argument("Invalid sensor type. Supported types: ultrasonic, infrared");
+        names.push_back(type);
     }
+    if (names.empty())
+        throw invalid_argument("Invalid sensor type. Supported types: ultrasonic, infrared");
 
-    else if (value == ULTRASONIC_SENSOR_VALUE)
-        sensor = new UltrasonicSensor(TRIG_PIN, ECHO_PIN);
-    else
-    {
-        cerr << "Invalid sensor type. Supported types: ultrasonic, infrared" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
-    sensor_type = value;
-    return "";
+    option_message << left << setw(message_length) << "Sensor used: " << value << "\n";
+    spec.sensors = names;
+    return option_message.str();
 }
 
 string handleNumberOfMeasurements(string value)
 {
     stringstream option_message;
-    int int_value = stoi(value);
-    if (int_value < 0)
-    {
-        cerr << "Invalid number of measurements value" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
+    double number = parse_number(value);
+    if (number < 0 || number != floor(number))
+        throw invalid_argument("Invalid number of measurements value");
     option_message << left << setw(message_length) << "Number of measurements per cycle: " << value << "\n";
-    number_of_measurements = int_value;
+    spec.samples = number;
     return option_message.str();
 }
 
 string handleRobot(string value)
 {
-    cout << "Using Meca500 robot\n"
-         << "Initialising robot EtherCAT interface" << endl;
-    initialise_robot();
-    return "";
+    spec.use_robot = true;
+    return "Using Meca500 robot\n";
 }
 
 string handleSurface(string value)
 {
     stringstream option_message;
     option_message << left << setw(message_length) << "Surface used: " << value << "\n";
-    surface_name = value;
+    spec.surface = value;
     return option_message.str();
 }
 
 string handleDelay(string value)
 {
     stringstream option_message;
-    int int_value = stoi(value);
-    if (int_value < 0)
-    {
-        cerr << "Invalid number of measures value" << endl;
-        cerr << "Program will now exit..." << endl;
-        exit(1);
-    }
+    double number = parse_number(value);
+    if (number < 0)
+        throw invalid_argument("Invalid measurement delay value");
     option_message << left << setw(message_length) << "Measurement delay in us used: " << value << "\n";
-    measurement_delay = int_value;
+    spec.delay_us = number;
     return option_message.str();
 }
 
 string handleConfig(string value)
 {
     stringstream option_message;
-    // value corresponds to the path of the config file given
-    setup_options(parse_config_file(value));
+    // value corresponds to the path of the config file given, its errors have already been printed
+    int errors = setup_options(parse_config_file(value));
+    if (errors > 0)
+        throw invalid_argument(to_string(errors) + " invalid options in " + value);
     return option_message.str();
 }
 
 string handleCalibration(string value)
 {
     stringstream option_message;
-    vector<float> calibration_values = parse_string_to_vector(value);
-
-    if (sensor != nullptr)
+    // a surface name is looked up in the registry by validate_spec, whatever the order of the options
+    if (!value.empty() && isalpha((unsigned char)value[0]))
     {
-        sensor->useCalibrationCurve(calibration_values[0], calibration_values[1]);
+        spec.calibration_surface = value;
+        option_message << left << setw(message_length) << "Calibration: ";
+        if (value == CALIBRATION_AUTO_VALUE)
+            option_message << "surface recognised before measuring\n";
+        else
+            option_message << "surface " << value << " of the registry\n";
+        return option_message.str();
     }
 
+    vector<float> calibration_values = parse_string_to_vector(value);
+    if (calibration_values.size() < 2)
+        throw invalid_argument("Invalid calibration parameters, not enough arguments");
+    // the sensors divide by m
+    if (calibration_values[0] == 0)
+        throw invalid_argument("Invalid calibration parameters, m can't be 0");
+    spec.calibration_line = calibration_values;
+    return option_message.str();
+}
+
+string handleRegistry(string value)
+{
+    stringstream option_message;
+    option_message << left << setw(message_length) << "Calibration registry: " << value << "\n";
+    spec.registry = value;
+    return option_message.str();
+}
+
+string handleSweep(string value)
+{
+    stringstream option_message;
+    double float_value = parse_number(value);
+    if (float_value <= 0)
+        throw invalid_argument("Invalid sweep velocity value");
+    option_message << left << setw(message_length) << "Sweep velocity in mm/s used: " << value << "\n";
+    spec.sweep_velocity = float_value;
+    return option_message.str();
+}
+
+string handleGpio(string value)
+{
+    stringstream option_message;
+    option_message << left << setw(message_length) << "GPIO backend used: " << value << "\n";
+    spec.gpio_backend = value;
+    return option_message.str();
+}
+
+string handleBurst(string value)
+{
+    stringstream option_message;
+    double number = parse_number(value);
+    if (number <= 0 || number != floor(number))
+        throw invalid_argument("Invalid number of pings per burst");
+    option_message << left << setw(message_length) << "Pings per burst: " << value << "\n";
+    spec.burst_pings = number;
+    return option_message.str();
+}
+
+string handlePrecision(string value)
+{
+    stringstream option_message;
+    double float_value = parse_number(value);
+    if (float_value <= 0)
+        throw invalid_argument("Invalid precision value");
+    option_message << left << setw(message_length) << "Target precision in mm used: " << value << "\n";
+    spec.precision = float_value;
+    return option_message.str();
+}
+
+string handleRefine(string value)
+{
+    stringstream option_message;
+    double float_value = parse_number(value);
+    if (float_value <= 0)
+        throw invalid_argument("Invalid refinement error value");
+    option_message << left << setw(message_length) << "Refinement error in mm used: " << value << "\n";
+    spec.refine_error = float_value;
+    return option_message.str();
+}
+
+string handleDryRun(string value)
+{
+    spec.dry_run = true;
+    return "Dry run: nothing will be measured\n";
+}
+
+string handleRobotLimits(string value)
+{
+    stringstream option_message;
+    vector<float> limits = parse_string_to_vector(value);
+    if (limits.size() < 2 || limits[0] <= 0 || limits[1] <= 0)
+        throw invalid_argument("Invalid robot limits, velocity and acceleration must be positive");
+    spec.robot_velocity = limits[0];
+    spec.robot_acceleration = limits[1];
+    option_message << left << setw(message_length) << "Robot limits: " << spec.robot_velocity << " mm/s, " << spec.robot_acceleration << " mm/s^2\n";
+    return option_message.str();
+}
+
+string handleResume(string value)
+{
+    spec.resume = true;
+    return "Resuming the run if its dataset exists\n";
+}
+
+string handlePort(string value)
+{
+    stringstream option_message;
+    option_message << left << setw(message_length) << "Infrared sensor port: " << value << "\n";
+    spec.port = value;
+    return option_message.str();
+}
+
+string handleHeadless(string value)
+{
+    spec.headless = true;
+    return "Headless run: the user won't be asked anything\n";
+}
+
+string handleFixture(string value)
+{
+    stringstream option_message;
+    if (value.empty())
+        throw invalid_argument("Missing fixture command");
+    option_message << left << setw(message_length) << "Fixture command: " << value << "\n";
+    spec.fixture = value;
+    return option_message.str();
+}
+
+string handleEvents(string value)
+{
+    stringstream option_message;
+    if (events_file != nullptr)
+        fclose(events_file);
+    events_file = fopen(value.c_str(), "a");
+    if (events_file == nullptr)
+        throw runtime_error("Cannot open the events file " + value);
+    option_message << left << setw(message_length) << "Events written to: " << value << "\n";
+    spec.events = value;
+    return option_message.str();
+}
+
+string handleBatch(string value)
+{
+    stringstream option_message;
+    option_message << left << setw(message_length) << "Job list: " << value << "\n";
+    spec.batch = value;
     return option_message.str();
 }
 
@@ -0,0 +1,346 @@
+#include "Dataset.hpp"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static_assert(sizeof(DatasetHeader) == 64, "the dataset header must be 64 bytes");
+static_assert(sizeof(DatasetIndexEntry) == 24, "the dataset index entries must be 24 bytes");
+
+/* DatasetWriter */
+DatasetWriter::DatasetWriter(const std::string &filename, const std::vector<std::string> &columns, bool resume)
+    : filename(filename), column_names(columns), step_columns(columns.size())
+{
+    namespace fs = std::filesystem;
+
+    for (const std::string &name : columns)
+    {
+        if (name.empty() || name.find('\n') != std::string::npos)
+            throw std::invalid_argument("Invalid dataset column name: " + name);
+    }
+
+    if (resume && fs::exists(filename) && !isPlaceholder(filename))
+    {
+        file = fopen(filename.c_str(), "r+b");
+        if (file == nullptr)
+            throw std::runtime_error("Cannot open the dataset " + filename);
+        try
+        {
+            if (fread(&trailer, sizeof(trailer), 1, file) != 1 || memcmp(trailer.magic, DATASET_MAGIC, sizeof(trailer.magic)) != 0 ||
+                trailer.version != DATASET_VERSION)
+                throw std::runtime_error("not a complete dataset");
+
+            std::string names(trailer.names_length, '\0'), expected_names;
+            for (const std::string &name : columns)
+                expected_names += name + "\n";
+            written_metadata.assign(trailer.metadata_length, '\0');
+            index.resize(trailer.steps);
+            if (fseek(file, trailer.names_offset, SEEK_SET) != 0 || fread(&names[0], 1, names.size(), file) != names.size() ||
+                fseek(file, trailer.metadata_offset, SEEK_SET) != 0 ||
+                fread(&written_metadata[0], 1, written_metadata.size(), file) != written_metadata.size() ||
+                fseek(file, trailer.index_offset, SEEK_SET) != 0 ||
+                fread(index.data(), sizeof(DatasetIndexEntry), index.size(), file) != index.size())
+                throw std::runtime_error("truncated file");
+            if (names != expected_names)
+                throw std::runtime_error("different columns");
+
+            std::stringstream metadata_stream(written_metadata);
+            std::string line;
+            while (std::getline(metadata_stream, line))
+            {
+                size_t pos = line.find('=');
+                if (pos != std::string::npos)
+                    metadata[line.substr(0, pos)] = line.substr(pos + 1);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            fclose(file);
+            file = nullptr;
+            throw std::runtime_error("Cannot resume the dataset " + filename + ": " + e.what());
+        }
+        fseek(file, 0, SEEK_END);
+        return;
+    }
+
+    fs::path dirPath = fs::path(filename).parent_path();
+    if (!dirPath.empty() && !fs::exists(dirPath))
+        fs::create_directories(dirPath);
+
+    file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+        throw std::runtime_error("Cannot create the dataset " + filename);
+
+    // placeholder, the header is completed by close()
+    DatasetHeader header = {};
+    fwrite(&header, sizeof(header), 1, file);
+}
+
+DatasetWriter::~DatasetWriter()
+{
+    close();
+}
+
+bool DatasetWriter::isPlaceholder(const std::string &filename)
+{
+    FILE *existing = fopen(filename.c_str(), "rb");
+    if (existing == nullptr)
+        return false;
+    DatasetHeader header;
+    bool complete = fread(&header, sizeof(header), 1, existing) == 1;
+    fclose(existing);
+    static const DatasetHeader placeholder = {};
+    return !complete || memcmp(&header, &placeholder, sizeof(header)) == 0;
+}
+
+void DatasetWriter::setMetadata(const std::string &key, const std::string &value)
+{
+    if (key.find('=') != std::string::npos || key.find('\n') != std::string::npos || value.find('\n') != std::string::npos)
+        throw std::invalid_argument("Invalid dataset metadata: " + key + "=" + value);
+    metadata[key] = value;
+}
+
+void DatasetWriter::beginStep(double key)
+{
+    endStep();
+    step_key = key;
+    in_step = true;
+}
+
+DatasetWriter &DatasetWriter::operator<<(const double new_val)
+{
+    row.push_back(new_val);
+    return *this;
+}
+
+void DatasetWriter::end_row()
+{
+    if (row.size() != column_names.size())
+    {
+        row.clear();
+        throw std::invalid_argument("Dataset row with a wrong number of values");
+    }
+    for (size_t i = 0; i < row.size(); i++)
+        step_columns[i].push_back(row[i]);
+    row.clear();
+}
+
+void DatasetWriter::endStep()
+{
+    if (!in_step || file == nullptr)
+        return;
+
+    // after a checkpoint the position is the end of its index
+    DatasetIndexEntry entry = {step_key, (uint64_t)ftell(file), step_columns.empty() ? 0 : step_columns[0].size()};
+    for (std::vector<double> &values : step_columns)
+    {
+        fwrite(values.data(), sizeof(double), values.size(), file);
+        values.clear();
+    }
+    index.push_back(entry);
+    in_step = false;
+}
+
+void DatasetWriter::writeAligned(const void *data, size_t length)
+{
+    static const char padding[8] = {};
+    fwrite(data, 1, length, file);
+    if (length % 8 != 0)
+        fwrite(padding, 1, 8 - length % 8, file);
+}
+
+void DatasetWriter::writeTrailer()
+{
+    endStep();
+
+    DatasetHeader header = trailer;
+    memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.version = DATASET_VERSION;
+    header.columns = column_names.size();
+    header.steps = index.size();
+
+    // names and metadata are written again only if they changed since the last checkpoint
+    if (header.names_offset == 0)
+    {
+        std::string names;
+        for (const std::string &name : column_names)
+            names += name + "\n";
+        header.names_offset = ftell(file);
+        header.names_length = names.size();
+        writeAligned(names.data(), names.size());
+    }
+
+    std::string metadata_lines;
+    for (const auto &item : metadata)
+        metadata_lines += item.first + "=" + item.second + "\n";
+    if (header.metadata_offset == 0 || metadata_lines != written_metadata)
+    {
+        header.metadata_offset = ftell(file);
+        header.metadata_length = metadata_lines.size();
+        writeAligned(metadata_lines.data(), metadata_lines.size());
+        written_metadata = metadata_lines;
+    }
+
+    header.index_offset = ftell(file);
+    fwrite(index.data(), sizeof(DatasetIndexEntry), index.size(), file);
+
+    // the new sections reach the disk before the header that points to them, an interruption leaves the previous checkpoint
+    fflush(file);
+    fsync(fileno(file));
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fflush(file);
+    fsync(fileno(file));
+    fseek(file, 0, SEEK_END);
+    trailer = header;
+}
+
+void DatasetWriter::checkpoint()
+{
+    if (file == nullptr)
+        return;
+    writeTrailer();
+}
+
+void DatasetWriter::close()
+{
+    if (file == nullptr)
+        return;
+    writeTrailer();
+    fclose(file);
+    file = nullptr;
+}
+
+/* DatasetReader */
+DatasetReader::DatasetReader(const std::string &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open the dataset " + filename);
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(DatasetHeader))
+    {
+        ::close(fd);
+        throw std::runtime_error("Not a dataset: " + filename);
+    }
+    size = status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Cannot map the dataset " + filename);
+    data = static_cast<const uint8_t *>(mapping);
+    // the steps are read once from start to end
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    header = reinterpret_cast<const DatasetHeader *>(data);
+    if (memcmp(header->magic, DATASET_MAGIC, sizeof(header->magic)) != 0 || header->version != DATASET_VERSION)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("Not a dataset or unsupported version: " + filename);
+    }
+
+    try
+    {
+        if (header->steps > size / sizeof(DatasetIndexEntry))
+            throw std::runtime_error("index larger than the file");
+        entries = reinterpret_cast<const DatasetIndexEntry *>(section(header->index_offset, header->steps * sizeof(DatasetIndexEntry)));
+        for (size_t step = 0; step < header->steps; step++)
+        {
+            if (header->columns > 0 && entries[step].rows > size / sizeof(double) / header->columns)
+                throw std::runtime_error("step larger than the file");
+            section(entries[step].offset, entries[step].rows * header->columns * sizeof(double));
+        }
+
+        std::string names(reinterpret_cast<const char *>(section(header->names_offset, header->names_length)), header->names_length);
+        std::stringstream names_stream(names);
+        std::string name;
+        while (std::getline(names_stream, name))
+            column_names.push_back(name);
+        if (column_names.size() != header->columns)
+            throw std::runtime_error("Corrupted column names");
+
+        std::string metadata_lines(reinterpret_cast<const char *>(section(header->metadata_offset, header->metadata_length)), header->metadata_length);
+        std::stringstream metadata_stream(metadata_lines);
+        std::string line;
+        while (std::getline(metadata_stream, line))
+        {
+            size_t pos = line.find('=');
+            if (pos != std::string::npos)
+                metadata_values[line.substr(0, pos)] = line.substr(pos + 1);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        munmap(mapping, size);
+        throw std::runtime_error("Invalid dataset " + filename + ": " + e.what());
+    }
+}
+
+DatasetReader::~DatasetReader()
+{
+    munmap(const_cast<uint8_t *>(data), size);
+}
+
+const uint8_t *DatasetReader::section(uint64_t offset, uint64_t length) const
+{
+    if (offset > size || length > size - offset)
+        throw std::runtime_error("section out of the file");
+    return data + offset;
+}
+
+const std::vector<std::string> &DatasetReader::columns() const
+{
+    return column_names;
+}
+
+size_t DatasetReader::column(const std::string &name) const
+{
+    for (size_t i = 0; i < column_names.size(); i++)
+    {
+        if (column_names[i] == name)
+            return i;
+    }
+    throw std::out_of_range("No column " + name + " in the dataset");
+}
+
+const std::map<std::string, std::string> &DatasetReader::metadata() const
+{
+    return metadata_values;
+}
+
+std::string DatasetReader::metadata(const std::string &key, const std::string &fallback) const
+{
+    auto item = metadata_values.find(key);
+    return item != metadata_values.end() ? item->second : fallback;
+}
+
+size_t DatasetReader::steps() const
+{
+    return header->steps;
+}
+
+double DatasetReader::stepKey(size_t step) const
+{
+    if (step >= header->steps)
+        throw std::out_of_range("Dataset step out of range");
+    return entries[step].key;
+}
+
+size_t DatasetReader::rows(size_t step) const
+{
+    if (step >= header->steps)
+        throw std::out_of_range("Dataset step out of range");
+    return entries[step].rows;
+}
+
+const double *DatasetReader::values(size_t step, size_t column) const
+{
+    if (step >= header->steps || column >= header->columns)
+        throw std::out_of_range("Dataset step or column out of range");
+    return reinterpret_cast<const double *>(data + entries[step].offset) + column * entries[step].rows;
+}
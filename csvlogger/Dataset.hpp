@@ -0,0 +1,141 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+Single-file dataset of a calibration run, in place of one csv file per distance.
+
+Layout (little endian, every section aligned to 8 bytes):
+    header      64 bytes, see DatasetHeader
+    steps       one chunk per step, column after column of rows doubles
+    names       column names, one per line
+    metadata    "key=value" lines (sensor, surface, robot pose, options...)
+    index       one DatasetIndexEntry per step, in the order the steps were written
+
+The header is written last, by close(): the reader refuses the file of a run interrupted before it.
+checkpoint() writes names, metadata and index after the steps so far and then the header, so a run
+checkpointed after every step can be read and resumed whenever it stops. The next steps are written
+after that index, whose space is left unused.
+*/
+
+#define DATASET_MAGIC "CALDATA1"
+#define DATASET_VERSION 1
+
+struct DatasetHeader
+{
+    char magic[8];            // DATASET_MAGIC
+    uint32_t version;         // DATASET_VERSION
+    uint32_t columns;         // number of columns of every step
+    uint64_t steps;           // number of steps in the index
+    uint64_t index_offset;    // offset of the index from the start of the file
+    uint64_t names_offset;    // offset of the column names
+    uint64_t names_length;    // length of the column names in bytes
+    uint64_t metadata_offset; // offset of the metadata
+    uint64_t metadata_length; // length of the metadata in bytes
+};
+
+struct DatasetIndexEntry
+{
+    double key;      // key of the step, i.e. the nominal distance in mm
+    uint64_t offset; // offset of the first column of the step
+    uint64_t rows;   // rows of the step, every column is rows doubles long
+};
+
+/**
+ * Writes a dataset with the same interface of CsvLogger: the values of a step are added row by row with << and
+ * end_row(), and stored column by column when the step ends.
+ */
+class DatasetWriter
+{
+private:
+    std::string filename;
+    FILE *file = nullptr;
+    std::vector<std::string> column_names;
+    std::map<std::string, std::string> metadata;
+    std::vector<DatasetIndexEntry> index;
+    std::vector<double> row;
+    std::vector<std::vector<double>> step_columns;
+    double step_key = 0;
+    bool in_step = false;
+    DatasetHeader trailer = {}; // sections of the last checkpoint, reused while they don't change
+    std::string written_metadata;
+
+    void writeAligned(const void *data, size_t length);
+    // Writes names, metadata and index at the end of the file, then the header pointing to them
+    void writeTrailer();
+
+public:
+    /**
+     * Creates the file and its directories, throws runtime_error if it can't be opened.
+     * With resume an existing dataset is continued: its steps and metadata are kept and new steps are added
+     * after them, throws runtime_error if it isn't a complete dataset with the same columns (a placeholder,
+     * see isPlaceholder, is created again)
+     */
+    DatasetWriter(const std::string &filename, const std::vector<std::string> &columns, bool resume = false);
+    ~DatasetWriter();
+
+    // True if the file was created but never checkpointed (header still zeroed or shorter than a header),
+    // i.e. the run stopped before its first step: resuming it recreates the file
+    static bool isPlaceholder(const std::string &filename);
+
+    // Metadata written in the file on close, a key set twice keeps the last value
+    void setMetadata(const std::string &key, const std::string &value);
+
+    // Starts a new step, ending the current one
+    void beginStep(double key);
+    DatasetWriter &operator<<(const double new_val);
+    // Throws invalid_argument if the row doesn't have a value for each column
+    void end_row();
+    // Writes the rows of the step, empty steps are kept in the index
+    void endStep();
+    // Ends the current step and makes the file a complete dataset of the steps so far, synced to the disk
+    void checkpoint();
+
+    // Writes names, metadata and index and completes the header
+    void close();
+};
+
+/**
+ * Memory-maps a dataset: the columns are read in place, without parsing.
+ * Every method throws runtime_error or out_of_range on invalid files or arguments.
+ */
+class DatasetReader
+{
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    const DatasetHeader *header = nullptr;
+    const DatasetIndexEntry *entries = nullptr;
+    std::vector<std::string> column_names;
+    std::map<std::string, std::string> metadata_values;
+
+    const uint8_t *section(uint64_t offset, uint64_t length) const;
+
+public:
+    DatasetReader(const std::string &filename);
+    ~DatasetReader();
+    DatasetReader(const DatasetReader &) = delete;
+    DatasetReader &operator=(const DatasetReader &) = delete;
+
+    const std::vector<std::string> &columns() const;
+    // Index of the column with the given name
+    size_t column(const std::string &name) const;
+
+    const std::map<std::string, std::string> &metadata() const;
+    // Value of a metadata key, fallback if it's missing
+    std::string metadata(const std::string &key, const std::string &fallback) const;
+
+    size_t steps() const;
+    double stepKey(size_t step) const;
+    size_t rows(size_t step) const;
+
+    // Values of a column of a step, rows(step) doubles valid as long as the reader
+    const double *values(size_t step, size_t column) const;
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+Micro-benchmark of the read strategies of the serial library.
+
+A ProximitySimulator on a pseudo terminal answers every "a" request with a frame of one byte
+per sensing element, paced at the byte time of the real UART. For each read mode the benchmark
+measures the latency of the request/answer transactions and, for the reading thread only,
+the read-like syscalls (/proc/thread-self/io, syscr) and the context switches (RUSAGE_THREAD).
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <sys/resource.h>
+#include <serial/serial.h>
+#include "ProximitySimulator.hpp"
+
+#define FRAMES_DEFAULT 2000
+#define ELEMENTS_DEFAULT 8
+#define BYTE_TIME_US_DEFAULT 10 // 1 Mbaud, 10 bits per byte
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct ThreadCounters
+{
+    long read_syscalls;
+    long context_switches;
+};
+
+ThreadCounters read_counters()
+{
+    ThreadCounters counters = {0, 0};
+    ifstream io("/proc/thread-self/io");
+    string key;
+    long value;
+    while (io >> key >> value)
+    {
+        if (key == "syscr:")
+            counters.read_syscalls = value;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    counters.context_switches = usage.ru_nvcsw + usage.ru_nivcsw;
+    return counters;
+}
+
+void run(string name, serial::readmode_t mode, string port, unsigned int frames, unsigned int elements)
+{
+    serial::Serial sensor(port, 1000000U, serial::Timeout::simpleTimeout(1000U));
+    sensor.setReadMode(mode);
+
+    vector<uint8_t> frame(elements);
+    vector<double> latency;
+    latency.reserve(frames);
+    unsigned int incomplete = 0;
+
+    ThreadCounters before = read_counters();
+    for (unsigned int i = 0; i < frames; i++)
+    {
+        Clock::time_point start = Clock::now();
+        sensor.write("a");
+        size_t received = sensor.read(frame.data(), elements);
+        latency.push_back(chrono::duration<double, micro>(Clock::now() - start).count());
+        if (received < elements)
+            incomplete++;
+    }
+    ThreadCounters after = read_counters();
+
+    sort(latency.begin(), latency.end());
+    double mean = 0;
+    for (double value : latency)
+        mean += value;
+    mean /= latency.size();
+
+    cout << left << setw(10) << name << right << fixed << setprecision(1)
+         << setw(12) << mean
+         << setw(12) << latency[latency.size() / 2]
+         << setw(12) << latency[(size_t)(latency.size() * 0.99)]
+         << setw(14) << (double)(after.read_syscalls - before.read_syscalls) / frames
+         << setw(14) << (double)(after.context_switches - before.context_switches) / frames
+         << setw(12) << incomplete << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    map<string, string> options;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        size_t pos = arg.find('=');
+        if (arg.substr(0, 2) == "--")
+            options[arg.substr(2, pos == string::npos ? string::npos : pos - 2)] = pos == string::npos ? "" : arg.substr(pos + 1);
+    }
+    if (options.count("help"))
+    {
+        cout << "Usage: ./serial_benchmark [--frames=COUNT] [--elements=COUNT] [--byte_time=US]" << endl;
+        return 0;
+    }
+
+    unsigned int frames = options.count("frames") ? stoul(options["frames"]) : FRAMES_DEFAULT;
+    unsigned int elements = options.count("elements") ? stoul(options["elements"]) : ELEMENTS_DEFAULT;
+
+    SimulatorConfig_t config;
+    config.NumSensingElements = elements;
+    config.ByteTimeUs = options.count("byte_time") ? stoul(options["byte_time"]) : BYTE_TIME_US_DEFAULT;
+    ProximitySimulator simulator(config);
+    simulator.start();
+
+    cout << frames << " frames of " << elements << " bytes, " << config.ByteTimeUs << " us per byte, on " << simulator.getPortName() << endl
+         << endl
+         << left << setw(10) << "mode" << right
+         << setw(12) << "mean [us]" << setw(12) << "p50 [us]" << setw(12) << "p99 [us]"
+         << setw(14) << "reads/frame" << setw(14) << "ctxsw/frame" << setw(12) << "incomplete" << endl;
+
+    run("select", serial::readmode_select, simulator.getPortName(), frames, elements);
+    run("frame", serial::readmode_frame, simulator.getPortName(), frames, elements);
+
+    simulator.stop();
+    return 0;
+}
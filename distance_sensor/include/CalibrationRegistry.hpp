@@ -0,0 +1,78 @@
+#ifndef CALIBRATIONREGISTRY_HPP
+#define CALIBRATIONREGISTRY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/*
+Binary table of the calibration lines of every sensor and surface (little endian):
+    header      24 bytes: magic "CALREG01", version, number of models, reference distance [mm]
+    models      80 bytes each, see SurfaceModel
+*/
+#define REGISTRY_MAGIC "CALREG01"
+#define REGISTRY_VERSION 1
+#define REGISTRY_SENSOR_LENGTH 16  // bytes of the sensor name, terminator included
+#define REGISTRY_SURFACE_LENGTH 40 // bytes of the surface name, terminator included
+
+// Calibration line of a sensor on a surface and the signature used to recognise the surface
+struct SurfaceModel
+{
+    string sensor;            // i.e. infrared
+    string surface;           // i.e. cartoncinobianco
+    float m;                  // measure = m * distance + q, the same m of useCalibrationCurve
+    float q;                  // same q of useCalibrationCurve [mm]
+    float r2;                 // coefficient of determination of the line
+    float reference_mean;     // mean measure with the surface at the reference distance [mm]
+    float reference_variance; // variance of the measures at the reference distance [mm^2]
+    uint32_t reference_count; // measures behind the signature, 0 if the reference distance wasn't measured
+};
+
+/**
+ * Calibration models of the surfaces, loaded once and queried by name or by the statistics of a
+ * few measures taken at the reference distance. Errors are thrown as runtime_error (files) and
+ * out_of_range (missing models).
+ */
+class CalibrationRegistry
+{
+private:
+    /*PRIVATE ATTRIBUTES*/
+    float _ReferenceDistance = 0;
+    vector<SurfaceModel> _Models;
+
+public:
+    /*CONSTRUCTOR*/
+    CalibrationRegistry(float reference_distance = 0);
+    /**
+     * Loads a registry written by save()
+     */
+    CalibrationRegistry(const string &filename);
+
+    /*PUBLIC METHODS*/
+    void save(const string &filename) const;
+
+    /**
+     * Adds a model, replacing the one with the same sensor and surface.
+     * Throws invalid_argument if the names don't fit in the table or the line can't be inverted (m = 0)
+     */
+    void add(const SurfaceModel &model);
+
+    float getReferenceDistance() const;
+    const vector<SurfaceModel> &getModels() const;
+
+    /**
+     * Model of a surface measured by a sensor
+     */
+    const SurfaceModel &find(const string &sensor, const string &surface) const;
+
+    /**
+     * Surface whose signature explains best the mean and variance observed by the sensor at the
+     * reference distance: the one with the lowest cross entropy between the normal distribution of
+     * the observed measures and the normal distribution of the stored ones
+     */
+    const SurfaceModel &match(const string &sensor, double mean, double variance) const;
+};
+
+#endif // CALIBRATIONREGISTRY_HPP
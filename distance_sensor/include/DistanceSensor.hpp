@@ -1,6 +1,15 @@
 #ifndef DISTANCESENSOR_HPP
 #define DISTANCESENSOR_HPP
-#include <pigpio.h>
+#include <cstdint>
+#include "Timebase.hpp"
+
+// Distance measurement stamped on the common timeline of the timebase module
+struct DistanceSample
+{
+    int64_t timestamp_ns; // time at which the distance was measured [ns]
+    float distance_mm;    // measured distance [mm]
+};
+
 class DistanceSensor
 {
 public:
@@ -17,6 +26,18 @@ public:
 
     // Virtual method to use calibration
     virtual void useCalibrationCurve(float m, float q) = 0;
+
+    // Virtual method to get a time-stamped distance in millimeters,
+    // by default stamped in the middle of the request to the sensor
+    virtual DistanceSample sampleInMillimeters()
+    {
+        DistanceSample sample;
+        int64_t request_time = timebase::now();
+        sample.distance_mm = getDistanceInMillimeters();
+        int64_t response_time = timebase::now();
+        sample.timestamp_ns = request_time + (response_time - request_time) / 2;
+        return sample;
+    }
 };
 
 #endif // DISTANCESENSOR_HPP
@@ -0,0 +1,54 @@
+#ifndef GPIOBACKEND_HPP
+#define GPIOBACKEND_HPP
+
+#include <string>
+#include <functional>
+#include <cstdint>
+
+using namespace std;
+
+/* Callback of an input pin: level of the pin after the edge (0 or 1) and tick of the edge in micro seconds */
+typedef function<void(int level, uint32_t tick)> GpioAlert;
+
+/**
+ * Access to the GPIO pins used by the sensors.
+ * The backends are:
+ * @li "pigpio": pigpio library on the Raspberry Pi (only when pigpio is found at build time)
+ * @li "gpiod" or "gpiod:/dev/gpiochipN": Linux GPIO character device, uAPI v2 (only on Linux)
+ * @li "simulated" or "simulated:PROFILE": echo pulses of an ultrasonic sensor looking at a
+ *     distance profile (see ProximitySimulator::parseProfile), runs on any machine
+ */
+class GpioBackend
+{
+public:
+    virtual ~GpioBackend() {}
+
+    // Configures the pin as an output
+    virtual void setOutput(uint8_t pin) = 0;
+
+    // Configures the pin as an input
+    virtual void setInput(uint8_t pin) = 0;
+
+    // Sets the level of an output pin
+    virtual void write(uint8_t pin, int level) = 0;
+
+    // Sends a pulse of pulseWidth micro seconds at the given level on an output pin
+    virtual void trigger(uint8_t pin, uint32_t pulseWidth, int level) = 0;
+
+    // Current tick in micro seconds, it wraps every ~72 minutes
+    virtual uint32_t tick() = 0;
+
+    // Calls alert on every edge of an input pin with the tick of the edge, nullptr to remove it.
+    // The alert is called from a thread of the backend.
+    virtual void setAlert(uint8_t pin, GpioAlert alert) = 0;
+
+    /**
+     * Creates the backend described by the string (see the list above); an empty string selects
+     * the default backend: pigpio if available, gpiod otherwise.
+     * Throws invalid_argument on unknown or unavailable backends and runtime_error if the
+     * backend can't be initialised.
+     */
+    static GpioBackend *create(const string &description = "");
+};
+
+#endif // GPIOBACKEND_HPP
@@ -0,0 +1,48 @@
+#ifndef GPIODBACKEND_HPP
+#define GPIODBACKEND_HPP
+
+#include "GpioBackend.hpp"
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+
+/**
+ * GPIO backend on the Linux GPIO character device (uAPI v2), without external libraries.
+ * The edges are timestamped by the kernel (CLOCK_MONOTONIC) when the interrupt is served,
+ * the tick is the same clock in micro seconds.
+ */
+class GpiodBackend : public GpioBackend
+{
+private:
+    struct AlertReader
+    {
+        GpioAlert alert;
+        thread reader;
+        atomic<bool> running;
+    };
+
+    string chipPath;
+    int chipFd;
+    map<uint8_t, int> lineFds; // one line request for each used pin
+    map<uint8_t, unique_ptr<AlertReader>> alertReaders;
+
+    // Requests the line of the pin with the given flags, releasing the previous request
+    void requestLine(uint8_t pin, uint64_t flags);
+
+    // Body of the alert threads: reads the edge events of the line
+    static void readEvents(int lineFd, AlertReader *reader);
+
+public:
+    GpiodBackend(const string &chipPath = "/dev/gpiochip0");
+    ~GpiodBackend();
+
+    void setOutput(uint8_t pin) override;
+    void setInput(uint8_t pin) override;
+    void write(uint8_t pin, int level) override;
+    void trigger(uint8_t pin, uint32_t pulseWidth, int level) override;
+    uint32_t tick() override;
+    void setAlert(uint8_t pin, GpioAlert alert) override;
+};
+
+#endif // GPIODBACKEND_HPP
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <map>
 
 #include <stdio.h>
 #include <string.h>
@@ -17,12 +18,29 @@
 #include <cstdint>
 #include <serial/serial.h>
 #include <DistanceSensor.hpp>
+#include <SerialReactor.hpp>
 
 // Private headers
 
 /* Sensor_t Structure and Line Structure definition */
 
 using namespace std;
+
+/* Duration of the phases of a serial transaction with the sensor, in nanoseconds */
+typedef struct
+{
+    int64_t write_ns; // sending the request
+    int64_t wait_ns;  // waiting for the first byte of the answer
+    int64_t read_ns;  // reading the whole frame
+} TransactionTiming;
+
+/* Entry of the port cache: sensor name (NO_SENSOR_NAME if none answered) and time of the probe */
+typedef struct
+{
+    std::string SensorName;
+    int64_t ProbeTime; // seconds since the epoch
+} PortCacheEntry;
+
 typedef struct
 {
     uint8_t SensorID;
@@ -39,6 +57,7 @@ class InfraredSensor : public DistanceSensor
 private:
     /*PRIVATE ATTRIBUTES*/
     vector<string> _DeviceName;
+    vector<string> _DeviceHardwareID;
     vector<Sensor_t> _SensorList;
     uint8_t _SelectedSensorID;
     serial::Serial *_SensorSerial;
@@ -46,8 +65,15 @@ private:
     bool calibrationEnabled = false;
     float m_cal;
     float q_cal;
+    bool transactionTimingEnabled = false;
+    TransactionTiming lastTransactionTiming = {0, 0, 0};
 
     /*PRIVATE METHODS*/
+    /**
+     * This function sends the string of the sensing elements to enable to a P--- sensor
+     */
+    void enable_sensing_elements(string toEnable);
+
     /**
      * This function return the calibrated measure based on the spoilt measure to calibrate ad the calibration line
      */
@@ -69,10 +95,31 @@ private:
      */
     uint8_t enumerate_ports(vector<string> &deviceName);
 
+    /**
+     * @Brief This routine checks if a sensor is attached to the given Serial Port
+     * reading the sensor name with a short timeout.
+     * Returns false if the port can't be opened; sensorName is empty if no sensor answered.
+     */
+    bool probe_port(string serialPortName, string &sensorName);
+
+    /**
+     * @Brief Load and save the cache of the probed ports, to skip the ports without a sensor at the next start.
+     */
+    map<string, PortCacheEntry> load_port_cache(void);
+    void save_port_cache(const map<string, PortCacheEntry> &cache);
+
+    /**
+     * @Brief Probes the given ports concurrently: names[k] is the sensor name on port k (empty if none
+     * answered) and probed[k] is set if port k could be opened.
+     */
+    void probe_ports(const vector<uint8_t> &ports, vector<string> &names, vector<uint8_t> &probed);
+
     /**
      * @Brief This routine inizializes the sensors attached to the Serial Ports.
      * It enumerates all the serial ports and if a compatible port is available checks
      * the presence of a Tactile or Proximity sensor reading the sensor ID.
+     * The ports are probed concurrently and the result is cached: the ports without a sensor are
+     * skipped for PORT_CACHE_NEGATIVE_TTL_S, or until no sensor is found on the other ports.
      */
     void init_sensor(void);
 
@@ -96,7 +143,17 @@ private:
 
 public:
     /*CONSTRUCTOR*/
+    /**
+     * Probes all the serial ports: with USER_INPUT the user selects the sensor,
+     * with ENABLE_ALL or ENABLE_FIRST the first sensor found is used with all
+     * or only the first sensing element enabled
+     */
     InfraredSensor(int argc);
+    /**
+     * Uses the sensor on the given serial port without asking the user,
+     * enabling the sensing elements listed in toEnable
+     */
+    InfraredSensor(string serialPort, string toEnable = "utlr");
 
     static const int USER_INPUT = 1U;
     static const int ENABLE_ALL = 2U;
@@ -108,6 +165,17 @@ public:
     float getDistanceInCentimeters() override;
     float getDistanceInMillimeters() override;
     void useCalibrationCurve(float m, float q) override;
+
+    // When enabled every reading measures the write/wait/read phases of the serial transaction
+    void enableTransactionTiming(bool enable);
+    TransactionTiming getLastTransactionTiming();
+
+    /**
+     * Registers the sensor in a reactor sampling many sensors at once: every frame has one raw
+     * reading in mm for each sensing element (not calibrated).
+     * Only P--- sensors are supported; throws invalid_argument for the others.
+     */
+    size_t attachToReactor(SerialReactor &reactor, FrameCallback callback);
 };
 
 #endif /* INFRAREDSENSOR_HPP */
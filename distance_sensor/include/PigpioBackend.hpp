@@ -0,0 +1,31 @@
+#ifndef PIGPIOBACKEND_HPP
+#define PIGPIOBACKEND_HPP
+
+#include "GpioBackend.hpp"
+#include <map>
+
+/**
+ * GPIO backend on the pigpio library (Raspberry Pi).
+ * The edges are reported by pigpio with the hardware tick at which they were sampled.
+ */
+class PigpioBackend : public GpioBackend
+{
+private:
+    map<uint8_t, GpioAlert> alerts;
+
+    // pigpio callback, userdata is the alert of the pin
+    static void onAlert(int gpio, int level, uint32_t tick, void *userdata);
+
+public:
+    PigpioBackend();
+    ~PigpioBackend();
+
+    void setOutput(uint8_t pin) override;
+    void setInput(uint8_t pin) override;
+    void write(uint8_t pin, int level) override;
+    void trigger(uint8_t pin, uint32_t pulseWidth, int level) override;
+    uint32_t tick() override;
+    void setAlert(uint8_t pin, GpioAlert alert) override;
+};
+
+#endif // PIGPIOBACKEND_HPP
@@ -0,0 +1,103 @@
+#ifndef PROXIMITYSIMULATOR_HPP
+#define PROXIMITYSIMULATOR_HPP
+
+#include <string>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <cstdint>
+
+using namespace std;
+
+/* Distance seen by the simulated sensor [mm] as a function of the time from the start [s] */
+typedef function<float(double)> DistanceProfile;
+
+typedef struct
+{
+    string SensorName = "P001";      // answer to the "b" handshake, a "P" marks a proximity sensor
+    uint8_t NumSensingElements = 1U; // answer to the "c" request
+    uint32_t LatencyUs = 0U;         // delay before answering a request in micro seconds
+    uint32_t LatencyJitterUs = 0U;   // uniform random jitter added to the latency in micro seconds
+    float NoiseMm = 0.0f;            // standard deviation of the gaussian noise on the readings
+    double DropProbability = 0.0;    // probability of dropping each byte of an answer
+    uint32_t ByteTimeUs = 0U;        // time to transmit each byte of an answer, 0 to send it at once (10 us at 1 Mbaud)
+    DistanceProfile Profile;         // distance of the obstacle, 100 mm if not set
+} SimulatorConfig_t;
+
+/**
+ * Simulator of the proximity sensor board on a pseudo terminal.
+ * It implements the serial protocol used by InfraredSensor:
+ * @li "b": 4 bytes sensor name (handshake used by init_sensor)
+ * @li "c": 1 byte number of sensing elements
+ * @li "a": 1 byte reading in mm for each sensing element
+ * @li any other byte (i.e. the enable string "utlr") is accepted silently
+ * The returned port name can be opened by InfraredSensor like a real /dev/ttyUSB* device.
+ */
+class ProximitySimulator
+{
+private:
+    /*PRIVATE ATTRIBUTES*/
+    SimulatorConfig_t _Config;
+    int _MasterFd = -1;
+    int _SlaveFd = -1;
+    string _PortName;
+    thread _Thread;
+    atomic<bool> _Running;
+    atomic<uint64_t> _RequestsServed;
+    mt19937 _Generator;
+
+    /*PRIVATE METHODS*/
+    /**
+     * Thread body: waits for requests on the pty master and answers them
+     */
+    void serve();
+
+    /**
+     * Sends the answer applying latency and dropped bytes
+     */
+    void answer(const string &data);
+
+    /**
+     * Returns the current reading of the sensing elements in mm
+     */
+    string readings(double elapsedSeconds);
+
+public:
+    /*CONSTRUCTOR*/
+    ProximitySimulator(SimulatorConfig_t config = SimulatorConfig_t());
+    ~ProximitySimulator();
+
+    /*PUBLIC METHODS*/
+    /**
+     * Creates the pseudo terminal and starts answering in a background thread.
+     * Throws runtime_error if the pty can't be created.
+     */
+    void start();
+
+    /**
+     * Stops the background thread and closes the pseudo terminal.
+     */
+    void stop();
+
+    /**
+     * Returns the path of the slave side of the pty, i.e. /dev/pts/3
+     */
+    string getPortName();
+
+    /**
+     * Returns the number of "a" requests answered so far
+     */
+    uint64_t getRequestsServed();
+
+    /**
+     * Builds a distance profile from a string:
+     * @li "constant:D" fixed distance D
+     * @li "ramp:MIN,MAX,PERIOD" triangle wave between MIN and MAX with the given period in seconds
+     * @li "sine:MEAN,AMPLITUDE,PERIOD" sine wave
+     * Throws invalid_argument on unknown profiles.
+     */
+    static DistanceProfile parseProfile(const string &description);
+};
+
+#endif /* PROXIMITYSIMULATOR_HPP */
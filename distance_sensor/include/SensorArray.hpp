@@ -0,0 +1,87 @@
+#ifndef SENSORARRAY_HPP
+#define SENSORARRAY_HPP
+
+#include "DistanceSensor.hpp"
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+/* Measurement of one sensor of the array, by default sensor.sampleInMillimeters() */
+typedef function<DistanceSample(DistanceSensor &sensor)> SensorSampler;
+
+// Samples of all the sensors of an array taken in the same tick
+struct ArraySample
+{
+    int64_t timestamp_ns;           // mean of the timestamps of the samples [ns]
+    int64_t skew_ns;                // spread between the first and the last timestamp of the samples [ns]
+    vector<DistanceSample> samples; // one sample for each sensor, in the order they were added
+};
+
+/**
+ * Group of distance sensors measuring together.
+ * Every sensor has a worker thread: sample() releases all the workers at the same time and
+ * waits for their samples, so a slow sensor (i.e. the ultrasonic ping) doesn't delay the others
+ * and the samples of a tick are taken as close in time as the sensors allow.
+ * The array takes the ownership of the sensors.
+ */
+class SensorArray
+{
+private:
+    /*PRIVATE ATTRIBUTES*/
+    struct Member
+    {
+        DistanceSensor *sensor;
+        string name;
+        SensorSampler sampler;
+        thread worker;
+    };
+    vector<Member *> _Members;
+
+    mutex _TickMutex;
+    condition_variable _TickCondition; // a new tick started or the array is being destroyed
+    condition_variable _DoneCondition; // a worker finished its sample
+    uint64_t _Tick = 0;
+    size_t _Pending = 0;
+    bool _Running = true;
+    vector<DistanceSample> _Samples;
+
+    /*PRIVATE METHODS*/
+    /**
+     * Body of the worker thread of a sensor: one sample for each tick after served
+     */
+    void work(size_t index, uint64_t served);
+
+public:
+    /*CONSTRUCTOR*/
+    SensorArray() {}
+    ~SensorArray();
+    SensorArray(const SensorArray &) = delete;
+    SensorArray &operator=(const SensorArray &) = delete;
+
+    /*PUBLIC METHODS*/
+    /**
+     * Adds a sensor to the array and starts its worker, returns the index of the sensor.
+     * sampler replaces sampleInMillimeters (i.e. to measure with a burst of pings).
+     */
+    size_t addSensor(DistanceSensor *sensor, const string &name, SensorSampler sampler = nullptr);
+
+    /**
+     * Number of sensors in the array
+     */
+    size_t size();
+
+    DistanceSensor &getSensor(size_t index);
+    string getName(size_t index);
+
+    /**
+     * Triggers all the sensors together and returns their samples when all of them answered
+     */
+    ArraySample sample();
+};
+
+#endif // SENSORARRAY_HPP
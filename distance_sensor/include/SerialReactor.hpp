@@ -0,0 +1,74 @@
+#ifndef SERIALREACTOR_HPP
+#define SERIALREACTOR_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <serial/serial.h>
+
+using namespace std;
+
+/* Answer of a sensor to a request of the reactor */
+struct SerialFrame
+{
+    size_t sensor;        // index returned by SerialReactor::addSensor
+    vector<uint8_t> data; // frame bytes
+    int64_t request_ns;   // timeline time at which the request was written [ns]
+    int64_t response_ns;  // timeline time at which the last byte was read [ns]
+};
+
+typedef function<void(const SerialFrame &frame)> FrameCallback;
+
+/**
+ * Single threaded reactor sampling many serial sensors at once (Linux, epoll).
+ * sample() writes the request of every sensor back-to-back and then reads the answers as their
+ * bytes arrive, so the time of a sample is the one of the slowest sensor instead of the sum.
+ * The ports are used through their file descriptors: they must not be read or written by other
+ * threads while the reactor is sampling.
+ */
+class SerialReactor
+{
+private:
+    struct Channel
+    {
+        serial::Serial *port;
+        int fd;
+        string request;
+        size_t frameLength;
+        FrameCallback callback;
+        vector<uint8_t> buffer;
+        bool pending;
+        int64_t request_ns;
+    };
+
+    int epollFd;
+    vector<Channel> channels;
+    uint64_t lostFrames = 0;
+
+public:
+    SerialReactor();
+    ~SerialReactor();
+
+    /**
+     * Registers an open port: request is written at every sample and the answer is complete after
+     * frameLength bytes. Returns the index of the sensor used in the frames.
+     * Throws runtime_error if the port can't be added to epoll.
+     */
+    size_t addSensor(serial::Serial *port, const string &request, size_t frameLength, FrameCallback callback);
+
+    /**
+     * Requests a frame to every sensor and delivers the complete frames to the callbacks, in order of arrival.
+     * The incomplete frames after timeout_ms are discarded (their input is flushed).
+     * Returns the number of complete frames.
+     */
+    size_t sample(int timeout_ms);
+
+    // Number of sensors
+    size_t size();
+
+    // Frames discarded because incomplete at the timeout or because the request couldn't be written
+    uint64_t getLostFrames();
+};
+
+#endif // SERIALREACTOR_HPP
@@ -0,0 +1,50 @@
+#ifndef SIMULATEDGPIOBACKEND_HPP
+#define SIMULATEDGPIOBACKEND_HPP
+
+#include "GpioBackend.hpp"
+#include "ProximitySimulator.hpp"
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+
+/**
+ * GPIO backend simulating an ultrasonic sensor (HC-SR04 like) on any machine.
+ * Every trigger pulse produces, on all the pins with an alert, an echo pulse as long as the
+ * round trip of the sound to the distance of the profile (plus gaussian noise).
+ * The edges are reported with their exact ticks, like the hardware timestamps of the real backends.
+ */
+class SimulatedGpioBackend : public GpioBackend
+{
+private:
+    DistanceProfile profile;
+    float noiseMm;
+    chrono::steady_clock::time_point start;
+    map<uint8_t, GpioAlert> alerts;
+    mutex mtx;
+    condition_variable triggered;
+    bool pendingTrigger = false;
+    uint32_t triggerTick;
+    bool running = true;
+    thread echoGenerator;
+    mt19937 generator;
+
+    // Body of the thread generating the echo pulses
+    void generateEchoes();
+
+public:
+    // The default profile is an obstacle at 100 mm
+    SimulatedGpioBackend(DistanceProfile profile = nullptr, float noiseMm = 0.0f);
+    ~SimulatedGpioBackend();
+
+    void setOutput(uint8_t pin) override;
+    void setInput(uint8_t pin) override;
+    void write(uint8_t pin, int level) override;
+    void trigger(uint8_t pin, uint32_t pulseWidth, int level) override;
+    uint32_t tick() override;
+    void setAlert(uint8_t pin, GpioAlert alert) override;
+};
+
+#endif // SIMULATEDGPIOBACKEND_HPP
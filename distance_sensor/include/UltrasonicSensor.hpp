@@ -2,8 +2,12 @@
 #define ULTRASONICSENSOR_HPP
 
 #include "DistanceSensor.hpp"
-#include <pigpio.h>
+#include "GpioBackend.hpp"
 #include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 /*CONSTANTS*/
 #define SOUND_SPEED_MS 343
@@ -12,6 +16,23 @@
 #define US_ROUNDTRIP_IN 146        // Microseconds (uS) it takes sound to travel round-trip 1 inch (2 inches total), uses integer to save compiled code space. Default=146
 #define TRIGGER_WIDTH 20
 #define MAX_SENSOR_DELAY 5800 // Maximum uS it takes for sensor to start the ping. Default=5800
+#define ALERT_LATENCY 2000    // Maximum uS the GPIO backend takes to deliver an edge to the alert callback
+#define PING_PERIOD_MS 60     // Default period of the background pings, the sensor needs ~60ms between pings
+#define BURST_PINGS 15        // Default number of pings of a burst
+#define BURST_MEDIAN_WINDOW 5 // Pings of the running median used to reject the outliers of a burst
+#define BURST_OUTLIER_MM 20   // Maximum distance of a ping from the running median in a burst
+
+// Filtered distance of a burst of pings
+struct BurstEstimate
+{
+    int64_t timestamp_ns;        // mean timeline time of the accepted pings [ns]
+    float distance_mm;           // mean of the accepted pings [mm], -1 if no ping was accepted
+    float variance_mm2;          // variance of the accepted pings [mm^2]
+    float estimate_variance_mm2; // variance of the mean, variance_mm2 / accepted [mm^2]
+    unsigned int accepted;       // pings used for the estimate
+    unsigned int timeouts;       // pings without echo
+    unsigned int outliers;       // pings too far from the running median
+};
 
 class UltrasonicSensor : public DistanceSensor
 {
@@ -25,8 +46,52 @@ private:
     bool calibrationEnabled = false;
     float m_cal;
     float q_cal;
+    GpioBackend *gpio;
+    timebase::TickClock *tickClock;
+
+    // echo edges, written by the alert thread of the GPIO backend
+    std::mutex echoMutex;
+    std::condition_variable echoCondition;
+    bool waitingEcho = false;
+    bool riseSeen = false;
+    bool echoDone = false;
+    uint32_t riseTick;
+    uint32_t echoWidth;
+
+    // only one ping at a time on the trigger pin
+    std::mutex pingMutex;
+
+    // background ping scheduler
+    std::thread scheduler;
+    std::atomic<bool> scheduling;
+    std::mutex sampleMutex;
+    std::condition_variable sampleCondition;
+    DistanceSample latestSample = {0, -1};
+    uint64_t sampleCount = 0;
 
     /*PRIVATE METHODS*/
+    /**
+     * This function sends a ping and returns the distance in meters (-1 on time out).
+     * The echo pulse is timed with the gpio ticks of its edges, reported by the alert callback.
+     * echoTick is set to the gpio tick in the middle of the echo pulse, when the ping hit the obstacle
+     */
+    float ping(uint32_t &echoTick);
+
+    /**
+     * Single ping stamped on the timeline
+     */
+    DistanceSample pingSample();
+
+    /**
+     * Alert callback on the echo pin: tick is the time of the edge in micro seconds
+     */
+    void echoAlert(int level, uint32_t tick);
+
+    /**
+     * Body of the background thread: pings every period_ms and publishes the samples
+     */
+    void schedulePings(unsigned int period_ms);
+
     /**
      * This function return the calibrated measure based on the spoilt measure to calibrate ad the calibration line
      */
@@ -34,7 +99,12 @@ private:
 
 public:
     /*CONSTRUCTOR*/
-    UltrasonicSensor(uint8_t attachedTrigPin, uint8_t attachedEchoPin);
+    /**
+     * The sensor takes the ownership of the GPIO backend, nullptr selects the default backend
+     * (see GpioBackend::create)
+     */
+    UltrasonicSensor(uint8_t attachedTrigPin, uint8_t attachedEchoPin, GpioBackend *gpio = nullptr);
+    ~UltrasonicSensor();
 
     /*PUBLIC METHODS*/
     // Implementation of virtual methods to get distance in meters, centimeters, and millimeters
@@ -42,6 +112,29 @@ public:
     float getDistanceInCentimeters() override;
     float getDistanceInMillimeters() override;
     void useCalibrationCurve(float m, float q) override;
+    // Sample stamped with the gpio ticks of the echo pulse
+    DistanceSample sampleInMillimeters() override;
+
+    // Starts pinging in a background thread every period_ms milliseconds
+    void startPinging(unsigned int period_ms = PING_PERIOD_MS);
+    void stopPinging();
+    // Last sample of the background pings, returns immediately (distance -1 if there are none yet)
+    DistanceSample latest();
+    // Waits for the next sample of the background pings, or pings now if they are not running
+    DistanceSample next();
+
+    /**
+     * Fires the given number of pings at the maximum safe rate (see burstPeriodUs) and returns the
+     * mean of the pings with an echo closer than BURST_OUTLIER_MM to the running median of the
+     * BURST_MEDIAN_WINDOW pings around them, with its variance
+     */
+    BurstEstimate burst(unsigned int pings = BURST_PINGS);
+
+    /**
+     * Minimum period between pings in micro seconds: the sensor delay, the echo window for
+     * MAX_SENSOR_DISTANCE_CM and the same window again to let the late reflections fade
+     */
+    unsigned int burstPeriodUs();
 };
 
 #endif // ULTRASONICSENSOR_HPP
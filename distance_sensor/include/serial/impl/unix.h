@@ -110,6 +110,9 @@ public:
   void
   sendBreak (int duration);
 
+  bool
+  setLowLatency (bool enabled);
+
   void
   setBreak (bool level);
 
@@ -140,6 +143,18 @@ public:
   string
   getPort () const;
 
+  int
+  getNativeHandle () const;
+
+protected:
+  size_t
+  readFrame (uint8_t *buf, size_t size);
+
+  void
+  setVmin (size_t count);
+
+public:
+
   void
   setTimeout (Timeout &timeout);
 
@@ -176,6 +191,12 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  void
+  setReadMode (readmode_t readmode);
+
+  readmode_t
+  getReadMode () const;
+
   void
   readLock ();
 
@@ -207,6 +228,8 @@ private:
   bytesize_t bytesize_;       // Size of the bytes
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
+  readmode_t readmode_;       // Read strategy
+  unsigned char vmin_;        // VMIN of the termios settings, changed by readmode_frame
 
   // Mutex used to lock the read functions
   pthread_mutex_t read_mutex;
@@ -99,6 +99,9 @@ public:
   void
   sendBreak (int duration);
 
+  bool
+  setLowLatency (bool enabled);
+
   void
   setBreak (bool level);
 
@@ -165,6 +168,12 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  void
+  setReadMode (readmode_t readmode);
+
+  readmode_t
+  getReadMode () const;
+
   void
   readLock ();
 
@@ -193,6 +202,7 @@ private:
   bytesize_t bytesize_;       // Size of the bytes
   stopbits_t stopbits_;       // Stop Bits
   flowcontrol_t flowcontrol_; // Flow Control
+  readmode_t readmode_;       // Read strategy
 
   // Mutex used to lock the read functions
   HANDLE read_mutex;
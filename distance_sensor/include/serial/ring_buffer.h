@@ -0,0 +1,83 @@
+/*!
+ * \file serial/ring_buffer.h
+ *
+ * \section DESCRIPTION
+ *
+ * Ring buffer of the bytes read ahead by Serial::readline, so that a line
+ * is read with a few large reads instead of one read per byte.
+ */
+
+#ifndef SERIAL_RING_BUFFER_H
+#define SERIAL_RING_BUFFER_H
+
+#include <vector>
+#include <string>
+#include <serial/v8stdint.h>
+
+namespace serial {
+
+class RingBuffer
+{
+public:
+  explicit RingBuffer (size_t capacity = 4096);
+
+  /*! Number of buffered bytes */
+  size_t
+  size () const;
+
+  bool
+  empty () const;
+
+  /*!
+   * Returns the contiguous free space after the buffered bytes, growing the
+   * buffer when it's full. Write into it and then call commit.
+   *
+   * \param length Set to the number of bytes that can be written
+   */
+  uint8_t *
+  reserve (size_t &length);
+
+  /*! Adds the bytes written in the space returned by reserve */
+  void
+  commit (size_t length);
+
+  /*!
+   * Looks for eol in the first limit buffered bytes, starting from
+   * scanned (updated to skip the bytes already searched at the next call).
+   *
+   * \return Length of the line including eol, 0 if eol was not found
+   */
+  size_t
+  find (const std::string &eol, size_t limit, size_t &scanned);
+
+  /*! Pointer to the first buffered byte, the data is made contiguous */
+  const uint8_t *
+  data ();
+
+  /*!
+   * Removes length bytes from the front. The bytes stay in memory until
+   * the next reserve, so a pointer returned by data is still readable.
+   */
+  void
+  consume (size_t length);
+
+  /*! Copies up to length bytes into buffer and consumes them */
+  size_t
+  take (uint8_t *buffer, size_t length);
+
+  void
+  clear ();
+
+private:
+  // Rotates the storage so that the buffered bytes start at index 0
+  void
+  linearise ();
+
+  std::vector<uint8_t> data_;
+  size_t head_;
+  size_t size_;
+};
+
+} // namespace serial
+
+#endif // SERIAL_RING_BUFFER_H
@@ -44,6 +44,10 @@
 #include <exception>
 #include <stdexcept>
 #include <serial/v8stdint.h>
+#include <serial/ring_buffer.h>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 #define THROW(exceptionClass, message) throw exceptionClass(__FILE__, \
 __LINE__, (message) )
@@ -89,6 +93,21 @@ typedef enum {
   flowcontrol_hardware
 } flowcontrol_t;
 
+/*!
+ * Enumeration defines the possible read strategies of the serial port.
+ *
+ * readmode_select waits with select and sleeps for the expected byte times
+ * of multi-byte reads (the historical behaviour).
+ * readmode_frame sets VMIN to the size of the read, so that a single poll
+ * returns when the whole frame is in the input buffer, which is then read
+ * with one call and no byte time sleeps: meant for small fixed-size frames
+ * (Linux only, the other systems keep readmode_select).
+ */
+typedef enum {
+  readmode_select = 0,
+  readmode_frame
+} readmode_t;
+
 /*!
  * Structure for setting the timeout of the serial port, times are
  * in milliseconds.
@@ -336,6 +355,29 @@ public:
   std::string
   readline (size_t size = 65536, std::string eol = "\n");
 
+#if __cplusplus >= 201703L
+  /*! Reads a line without copying it.
+   *
+   * The port is read in chunks into an internal buffer and searched for the
+   * EOL with memchr, so a line costs about one read call instead of one per
+   * byte. The bytes after the line stay buffered and are returned by the
+   * next reads of any kind.
+   *
+   * \param line Set to the line, EOL included. It points into the internal
+   * buffer and is valid until the next call on this object.
+   * \param size A maximum length of a line, defaults to 65536 (2^16)
+   * \param eol A string to match against for the EOL.
+   *
+   * \return The length of the line, shorter than size and without EOL if
+   * the read timed out.
+   *
+   * \throw serial::PortNotOpenedException
+   * \throw serial::SerialException
+   */
+  size_t
+  readline (std::string_view &line, size_t size = 65536, std::string eol = "\n");
+#endif
+
   /*! Reads in multiple lines until the serial port times out.
    *
    * This requires a timeout > 0 before it can be run. It will read until a
@@ -421,6 +463,17 @@ public:
   std::string
   getPort () const;
 
+#if !defined(_WIN32)
+  /*! Gets the file descriptor of the open port, to wait on many ports
+   * with select/poll/epoll. The descriptor is non blocking and must not be
+   * closed; reading or writing it bypasses the locks of this object.
+   *
+   * \throw serial::PortNotOpenedException
+   */
+  int
+  getNativeHandle () const;
+#endif
+
   /*! Sets the timeout for reads and writes using the Timeout struct.
    *
    * There are two timeout conditions described here:
@@ -586,6 +639,17 @@ public:
   flowcontrol_t
   getFlowcontrol () const;
 
+  /*! Sets the read strategy of the port, see readmode_t.
+   *
+   * \param readmode readmode_select (default) or readmode_frame
+   */
+  void
+  setReadMode (readmode_t readmode);
+
+  /*! Gets the read strategy of the port. */
+  readmode_t
+  getReadMode () const;
+
   /*! Flush the input and output buffers */
   void
   flush ();
@@ -602,6 +666,18 @@ public:
   void
   sendBreak (int duration);
 
+  /*!
+   * Sets the low latency flag of the serial driver (TIOCSSERIAL ioctl on
+   * Linux), like "setserial <port> low_latency" without forking a shell.
+   *
+   * \return Returns false if the driver doesn't support the flag (i.e.
+   * pseudo terminals or non Linux systems).
+   *
+   * \throw serial::PortNotOpenedException
+   */
+  bool
+  setLowLatency (bool enabled = true);
+
   /*! Set the break condition to a given level.  Defaults to true. */
   void
   setBreak (bool level = true);
@@ -660,6 +736,13 @@ private:
   class ScopedReadLock;
   class ScopedWriteLock;
 
+  // Bytes read ahead by readline, returned first by every read
+  RingBuffer read_buffer_;
+
+  // Reads a line into read_buffer_, returns its length (see readline)
+  size_t
+  bufferLine_ (size_t size, const std::string &eol);
+
   // Read common function
   size_t
   read_ (uint8_t *buffer, size_t size);
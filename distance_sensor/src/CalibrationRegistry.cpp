@@ -0,0 +1,164 @@
+#include "CalibrationRegistry.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// the infrared sensor reads whole millimetres: a constant reading still hides the rounding variance
+#define REGISTRY_VARIANCE_FLOOR (1.0 / 12)
+
+struct RegistryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t models;
+    float reference_distance;
+    uint32_t reserved;
+};
+
+struct RegistryRecord
+{
+    char sensor[REGISTRY_SENSOR_LENGTH];
+    char surface[REGISTRY_SURFACE_LENGTH];
+    float m, q, r2;
+    float reference_mean, reference_variance;
+    uint32_t reference_count;
+};
+
+static_assert(sizeof(RegistryHeader) == 24, "the registry header must be 24 bytes");
+static_assert(sizeof(RegistryRecord) == 80, "the registry records must be 80 bytes");
+
+/*CONSTRUCTOR*/
+CalibrationRegistry::CalibrationRegistry(float reference_distance) : _ReferenceDistance(reference_distance)
+{
+}
+
+CalibrationRegistry::CalibrationRegistry(const string &filename)
+{
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == nullptr)
+        throw runtime_error("Cannot open the calibration registry " + filename);
+
+    RegistryHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, REGISTRY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != REGISTRY_VERSION)
+    {
+        fclose(file);
+        throw runtime_error("Not a calibration registry or unsupported version: " + filename);
+    }
+    _ReferenceDistance = header.reference_distance;
+
+    RegistryRecord record;
+    for (uint32_t i = 0; i < header.models; i++)
+    {
+        if (fread(&record, sizeof(record), 1, file) != 1)
+        {
+            fclose(file);
+            throw runtime_error("Truncated calibration registry " + filename);
+        }
+        // the names are terminated by the writer, the last byte is forced in case of a corrupted file
+        record.sensor[REGISTRY_SENSOR_LENGTH - 1] = '\0';
+        record.surface[REGISTRY_SURFACE_LENGTH - 1] = '\0';
+        _Models.push_back({record.sensor, record.surface, record.m, record.q, record.r2,
+                           record.reference_mean, record.reference_variance, record.reference_count});
+    }
+    fclose(file);
+}
+
+/*PUBLIC METHODS*/
+void CalibrationRegistry::save(const string &filename) const
+{
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+        throw runtime_error("Cannot create the calibration registry " + filename);
+
+    RegistryHeader header = {};
+    memcpy(header.magic, REGISTRY_MAGIC, sizeof(header.magic));
+    header.version = REGISTRY_VERSION;
+    header.models = _Models.size();
+    header.reference_distance = _ReferenceDistance;
+    fwrite(&header, sizeof(header), 1, file);
+
+    for (const SurfaceModel &model : _Models)
+    {
+        RegistryRecord record = {};
+        strncpy(record.sensor, model.sensor.c_str(), REGISTRY_SENSOR_LENGTH - 1);
+        strncpy(record.surface, model.surface.c_str(), REGISTRY_SURFACE_LENGTH - 1);
+        record.m = model.m;
+        record.q = model.q;
+        record.r2 = model.r2;
+        record.reference_mean = model.reference_mean;
+        record.reference_variance = model.reference_variance;
+        record.reference_count = model.reference_count;
+        fwrite(&record, sizeof(record), 1, file);
+    }
+
+    if (fclose(file) != 0)
+        throw runtime_error("Cannot write the calibration registry " + filename);
+}
+
+void CalibrationRegistry::add(const SurfaceModel &model)
+{
+    if (model.sensor.empty() || model.sensor.size() >= REGISTRY_SENSOR_LENGTH ||
+        model.surface.empty() || model.surface.size() >= REGISTRY_SURFACE_LENGTH)
+        throw invalid_argument("Invalid sensor or surface name for the registry: " + model.sensor + "/" + model.surface);
+    // the sensors divide by m
+    if (!isfinite(model.m) || model.m == 0 || !isfinite(model.q))
+        throw invalid_argument("Invalid calibration line for the registry: " + model.sensor + "/" + model.surface);
+
+    for (SurfaceModel &stored : _Models)
+    {
+        if (stored.sensor == model.sensor && stored.surface == model.surface)
+        {
+            stored = model;
+            return;
+        }
+    }
+    _Models.push_back(model);
+}
+
+float CalibrationRegistry::getReferenceDistance() const
+{
+    return _ReferenceDistance;
+}
+
+const vector<SurfaceModel> &CalibrationRegistry::getModels() const
+{
+    return _Models;
+}
+
+const SurfaceModel &CalibrationRegistry::find(const string &sensor, const string &surface) const
+{
+    for (const SurfaceModel &model : _Models)
+    {
+        if (model.sensor == sensor && model.surface == surface)
+            return model;
+    }
+    throw out_of_range("No calibration of " + sensor + " on " + surface + " in the registry");
+}
+
+const SurfaceModel &CalibrationRegistry::match(const string &sensor, double mean, double variance) const
+{
+    const SurfaceModel *best = nullptr;
+    double best_score = numeric_limits<double>::infinity();
+    variance = max(variance, REGISTRY_VARIANCE_FLOOR);
+    for (const SurfaceModel &model : _Models)
+    {
+        if (model.sensor != sensor || model.reference_count == 0)
+            continue;
+        // cross entropy of N(mean, variance) against N(reference_mean, reference_variance), constants dropped:
+        // it penalises both a different mean and a different spread of the measures
+        double reference_variance = max((double)model.reference_variance, REGISTRY_VARIANCE_FLOOR);
+        double difference = mean - model.reference_mean;
+        double score = log(reference_variance) + (variance + difference * difference) / reference_variance;
+        if (score < best_score)
+        {
+            best_score = score;
+            best = &model;
+        }
+    }
+    if (best == nullptr)
+        throw out_of_range("No surface with a signature for " + sensor + " in the registry");
+    return *best;
+}
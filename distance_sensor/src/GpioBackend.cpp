@@ -0,0 +1,53 @@
+#include "GpioBackend.hpp"
+#include "SimulatedGpioBackend.hpp"
+#include <stdexcept>
+#ifdef HAVE_PIGPIO
+#include "PigpioBackend.hpp"
+#endif
+#ifdef HAVE_GPIOD
+#include "GpiodBackend.hpp"
+#endif
+
+GpioBackend *GpioBackend::create(const string &description)
+{
+    size_t pos = description.find(':');
+    string type = description.substr(0, pos);
+    string argument = pos != string::npos ? description.substr(pos + 1) : "";
+
+    if (type.empty())
+    {
+#if defined(HAVE_PIGPIO)
+        type = "pigpio";
+#elif defined(HAVE_GPIOD)
+        type = "gpiod";
+#else
+        throw invalid_argument("No GPIO backend available on this machine, use --gpio=simulated");
+#endif
+    }
+
+    if (type == "pigpio")
+    {
+#ifdef HAVE_PIGPIO
+        return new PigpioBackend();
+#else
+        throw invalid_argument("The pigpio GPIO backend is not available: pigpio was not found at build time");
+#endif
+    }
+    if (type == "gpiod")
+    {
+#ifdef HAVE_GPIOD
+        return argument.empty() ? new GpiodBackend() : new GpiodBackend(argument);
+#else
+        throw invalid_argument("The gpiod GPIO backend is not available: linux/gpio.h v2 was not found at build time");
+#endif
+    }
+    if (type == "simulated")
+    {
+        // simulated:PROFILE@NOISE, i.e. simulated:sine:300,100,5@2
+        size_t at = argument.find('@');
+        string profile = argument.substr(0, at);
+        float noise = at != string::npos ? stof(argument.substr(at + 1)) : 0.0f;
+        return new SimulatedGpioBackend(profile.empty() ? nullptr : ProximitySimulator::parseProfile(profile), noise);
+    }
+    throw invalid_argument("Unknown GPIO backend: " + description + " (use pigpio, gpiod[:/dev/gpiochipN] or simulated[:PROFILE[@NOISE]])");
+}
@@ -0,0 +1,143 @@
+#include "GpiodBackend.hpp"
+#include <stdexcept>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+#define CONSUMER_NAME "distance_sensor"
+#define EVENT_POLL_TIMEOUT_MS 100 // period to check if the alert has been removed
+
+static uint64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+GpiodBackend::GpiodBackend(const string &chipPath)
+    : chipPath(chipPath)
+{
+    chipFd = open(chipPath.c_str(), O_RDWR | O_CLOEXEC);
+    if (chipFd < 0)
+        throw runtime_error("Error: cannot open " + chipPath + ": " + strerror(errno));
+}
+
+GpiodBackend::~GpiodBackend()
+{
+    for (auto &reader : alertReaders)
+    {
+        reader.second->running = false;
+        reader.second->reader.join();
+    }
+    for (auto &line : lineFds)
+        close(line.second);
+    close(chipFd);
+}
+
+void GpiodBackend::setOutput(uint8_t pin)
+{
+    requestLine(pin, GPIO_V2_LINE_FLAG_OUTPUT);
+}
+
+void GpiodBackend::setInput(uint8_t pin)
+{
+    // the edge detection is always enabled, so an alert can be added without a new request
+    requestLine(pin, GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING);
+}
+
+void GpiodBackend::write(uint8_t pin, int level)
+{
+    if (!lineFds.count(pin))
+        throw invalid_argument("Error: pin " + to_string(pin) + " is not configured");
+
+    struct gpio_v2_line_values values;
+    memset(&values, 0, sizeof(values));
+    values.mask = 1;
+    values.bits = level ? 1 : 0;
+    if (ioctl(lineFds[pin], GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0)
+        throw runtime_error("Error: cannot set pin " + to_string(pin) + ": " + strerror(errno));
+}
+
+void GpiodBackend::trigger(uint8_t pin, uint32_t pulseWidth, int level)
+{
+    // the pulse is a few micro seconds: a sleep would be much longer than requested
+    write(pin, level);
+    uint64_t end = monotonic_us() + pulseWidth;
+    while (monotonic_us() < end)
+    {
+    }
+    write(pin, !level);
+}
+
+uint32_t GpiodBackend::tick()
+{
+    return (uint32_t)monotonic_us();
+}
+
+void GpiodBackend::setAlert(uint8_t pin, GpioAlert alert)
+{
+    if (alertReaders.count(pin))
+    {
+        alertReaders[pin]->running = false;
+        alertReaders[pin]->reader.join();
+        alertReaders.erase(pin);
+    }
+    if (!alert)
+        return;
+    if (!lineFds.count(pin))
+        setInput(pin);
+
+    AlertReader *reader = new AlertReader;
+    reader->alert = alert;
+    reader->running = true;
+    reader->reader = thread(readEvents, lineFds[pin], reader);
+    alertReaders[pin].reset(reader);
+}
+
+/*PRIVATE*/
+void GpiodBackend::requestLine(uint8_t pin, uint64_t flags)
+{
+    if (alertReaders.count(pin))
+        setAlert(pin, nullptr);
+    if (lineFds.count(pin))
+    {
+        close(lineFds[pin]);
+        lineFds.erase(pin);
+    }
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = pin;
+    request.num_lines = 1;
+    strncpy(request.consumer, CONSUMER_NAME, sizeof(request.consumer) - 1);
+    request.config.flags = flags;
+
+    if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0)
+        throw runtime_error("Error: cannot request line " + to_string(pin) + " of " + chipPath + ": " + strerror(errno));
+    lineFds[pin] = request.fd;
+}
+
+void GpiodBackend::readEvents(int lineFd, AlertReader *reader)
+{
+    struct pollfd pfd = {lineFd, POLLIN, 0};
+    struct gpio_v2_line_event events[16];
+
+    while (reader->running)
+    {
+        if (poll(&pfd, 1, EVENT_POLL_TIMEOUT_MS) <= 0)
+            continue;
+
+        ssize_t bytes = read(lineFd, events, sizeof(events));
+        for (ssize_t k = 0; k < bytes / (ssize_t)sizeof(struct gpio_v2_line_event); k++)
+        {
+            int level = events[k].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? 1 : 0;
+            reader->alert(level, (uint32_t)(events[k].timestamp_ns / 1000));
+        }
+    }
+}
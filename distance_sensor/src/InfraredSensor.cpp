@@ -7,8 +7,20 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <thread>
+#include <cstdlib>
+#include <ctime>
+#include <sys/stat.h>
 #include <serial/serial.h>
 
+#define PROBE_TIMEOUT_MS 100U        // handshake timeout, the sensor answers in less than a millisecond
+#define PORT_CACHE_NAME "distance_sensor_ports" // port -> sensor name cache, in $XDG_CACHE_HOME or ~/.cache
+#define NO_SENSOR_NAME "-"           // cache entry of the ports without a sensor
+#define PORT_CACHE_NEGATIVE_TTL_S 86400 // a port without a sensor is probed again after a day
+
 using std::cerr;
 using std::cout;
 using std::endl;
@@ -21,50 +33,29 @@ using namespace std;
 /*CONSTRUCTOR*/
 InfraredSensor::InfraredSensor(int argc)
 {
-    // calibrationLine = calibration_line;
-    char enable_all[] = "utlr";
-    char *argv[] = {"test", "/dev/ttyUSB0", "/dev/ttyUSB1", "/dev/ttyUSB2", "/dev/ttyUSB3"};
-    char *to_enable;
-    /* Sensor Initialization */
-    if (argc == 1U)
+    /* Sensor Initialization: all the ports are probed, the user chooses the sensor only with USER_INPUT */
+    init_sensor();
+    if (argc == USER_INPUT)
     {
-        init_sensor();
         select_sensor(_SensorList, false);
-        to_enable = enable_all;
-    }
-    else if (argc == 2U)
-    {
-        if (strlen(argv[1]) > 4)
-        {
-            string userInput = argv[1];
-            init_sensor(userInput);
-            select_sensor(_SensorList, true);
-            to_enable = enable_all;
-        }
-        else
-        {
-            init_sensor();
-            select_sensor(_SensorList, false);
-            to_enable = argv[1];
-        }
+        enable_sensing_elements("utlr");
     }
-    else if (argc == 3U)
+    else
     {
-        init_sensor(argv[1]);
+        /* First sensor found, with all or only the first sensing element enabled */
+        if (255U != _SelectedSensorID)
+            _SelectedSensorID = 0U;
         select_sensor(_SensorList, true);
-        to_enable = argv[2];
-    }
-
-    /* Set Publisher and Rate for P--- Sensors */
-    uint16_t rate = 0U;
-    if (strstr((char *)_SensorList.at(_SelectedSensorID).SensorName.c_str(), "P"))
-    {
-        size_t bytes_wrote = _SensorSerial->write(to_enable);
-        string topicName_raw = "ProximityData" + _SensorList.at(_SelectedSensorID).SerialPort + "_" + _SensorList.at(_SelectedSensorID).SensorName;
-        replace(topicName_raw.begin(), topicName_raw.end(), '/', '_');
-        rate = 50U;
+        enable_sensing_elements(argc == ENABLE_FIRST ? "u" : "utlr");
     }
+}
 
+InfraredSensor::InfraredSensor(string serialPort, string toEnable)
+{
+    /* Sensor Initialization on the given port, no user input needed */
+    init_sensor(serialPort);
+    select_sensor(_SensorList, true);
+    enable_sensing_elements(toEnable);
 }
 
 /*PUBLIC*/
@@ -78,10 +69,14 @@ float InfraredSensor::getDistanceInCentimeters()
 }
 float InfraredSensor::getDistanceInMillimeters() // here is implemented the calibration
 {
+    vector<uint8_t> data = getDistanceInMillimetersVector();
+    if (data.empty())
+        return -1; // frame lost, same convention of the ultrasonic timeout
+
     if (calibrationEnabled)
-        return getCalibratedDistance(getDistanceInMillimetersVector()[0]);
+        return getCalibratedDistance(data[0]);
     else
-        return getDistanceInMillimetersVector()[0];
+        return data[0];
 }
 
 void InfraredSensor::useCalibrationCurve(float m, float q)
@@ -91,8 +86,35 @@ void InfraredSensor::useCalibrationCurve(float m, float q)
     calibrationEnabled = true;
 }
 
+void InfraredSensor::enableTransactionTiming(bool enable)
+{
+    transactionTimingEnabled = enable;
+}
+
+TransactionTiming InfraredSensor::getLastTransactionTiming()
+{
+    return lastTransactionTiming;
+}
+
+size_t InfraredSensor::attachToReactor(SerialReactor &reactor, FrameCallback callback)
+{
+    if (!strstr((char *)_SensorList.at(_SelectedSensorID).SensorName.c_str(), "P"))
+        throw invalid_argument("Only proximity (P---) sensors can be sampled by the reactor");
+
+    return reactor.addSensor(_SensorSerial, "a", _SensorList.at(_SelectedSensorID).NumSensingElements, callback);
+}
+
 /*PRIVATE*/
 
+void InfraredSensor::enable_sensing_elements(string toEnable)
+{
+    /* Enable the sensing elements of P--- Sensors */
+    if (strstr((char *)_SensorList.at(_SelectedSensorID).SensorName.c_str(), "P"))
+    {
+        _SensorSerial->write(toEnable);
+    }
+}
+
 float InfraredSensor::getCalibratedDistance(float spoiltMeasure)
 {
     return (spoiltMeasure - q_cal) / m_cal;
@@ -111,9 +133,34 @@ vector<uint8_t> InfraredSensor::getDistanceInMillimetersVector()
     if (strstr((char *)_SensorList.at(_SelectedSensorID).SensorName.c_str(), "P"))
     {
         /* Request sensor data */
-        size_t bytes_wrote = _SensorSerial->write("a");
+        if (transactionTimingEnabled)
+        {
+            /* Same transaction split in write, wait for the first byte and read of the frame */
+            int64_t start = timebase::now();
+            _SensorSerial->write("a");
+            int64_t written = timebase::now();
+            _SensorSerial->waitReadable();
+            int64_t readable = timebase::now();
+            _SensorSerial->read(dataRaw, _SensorList.at(_SelectedSensorID).NumSensingElements);
+            int64_t done = timebase::now();
+
+            lastTransactionTiming.write_ns = written - start;
+            lastTransactionTiming.wait_ns = readable - written;
+            lastTransactionTiming.read_ns = done - readable;
+        }
+        else
+        {
+            _SensorSerial->write("a");
+            _SensorSerial->read(dataRaw, _SensorList.at(_SelectedSensorID).NumSensingElements);
+        }
 
-        _SensorSerial->read(dataRaw, _SensorList.at(_SelectedSensorID).NumSensingElements);
+        /* Incomplete frame (bytes lost or read timeout): discard it and resynchronise on the next request */
+        if (dataRaw.size() < _SensorList.at(_SelectedSensorID).NumSensingElements)
+        {
+            _SensorSerial->flushInput();
+            dataRaw.clear();
+            return dataRaw;
+        }
 
         /* Fill data buffer and ROS msg */
         for (int k = 0U; k < _SensorList.at(_SelectedSensorID).NumSensingElements; k++)
@@ -150,6 +197,7 @@ uint8_t InfraredSensor::enumerate_ports(vector<string> &deviceName)
             // printf( "(%s, %s, %s) %d\n", device.port.c_str(), device.description.c_str(), device.hardware_id.c_str(), distance(devices_found.begin(), iter) );
             // printf( "(%s, %s, %s) ID: %d\n", devices_found.at(32).port.c_str() , device.description.c_str(), device.hardware_id.c_str(), distance(devices_found.begin(), DeviceID) );
             deviceName.push_back(device.port);
+            _DeviceHardwareID.push_back(device.hardware_id);
         }
     }
 
@@ -157,10 +205,111 @@ uint8_t InfraredSensor::enumerate_ports(vector<string> &deviceName)
     return deviceName.size();
 }
 
+/**
+ * @Brief This routine checks if a sensor is attached to the given Serial Port
+ * sending the "b" request and waiting PROBE_TIMEOUT_MS for the 4 bytes sensor name.
+ * Returns false if the port can't be opened; sensorName is empty if no sensor answered.
+ */
+bool InfraredSensor::probe_port(string serialPortName, string &sensorName)
+{
+    sensorName.clear();
+    try
+    {
+        /* port, baudrate, timeout in milliseconds */
+        serial::Serial my_serial(serialPortName, 1000000U, serial::Timeout::simpleTimeout(PROBE_TIMEOUT_MS));
+        my_serial.flushInput();
+
+        if (my_serial.write("b") > 0U)
+        {
+            string result = my_serial.read(4U);
+            if (4U == result.length())
+                sensorName = result;
+        }
+
+        my_serial.close();
+    }
+    catch (std::exception &e)
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @Brief Path of the port cache file: $XDG_CACHE_HOME/PORT_CACHE_NAME or ~/.cache/PORT_CACHE_NAME
+ */
+static string port_cache_path(void)
+{
+    const char *cacheHome = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (cacheHome && cacheHome[0])
+        return string(cacheHome) + "/" + PORT_CACHE_NAME;
+    if (home && home[0])
+        return string(home) + "/.cache/" + PORT_CACHE_NAME;
+    return "";
+}
+
+/**
+ * @Brief The cache has a line for each probed port: port, hardware ID, sensor name and time of the probe
+ * separated by tabs. The map key is "port\thardware ID", so that a different device on the same port is
+ * probed again. Lines without the time (older caches) are kept with time 0, so their negative entries
+ * are already expired.
+ */
+map<string, PortCacheEntry> InfraredSensor::load_port_cache(void)
+{
+    map<string, PortCacheEntry> cache;
+    ifstream file(port_cache_path());
+    string line;
+    while (getline(file, line))
+    {
+        vector<string> fields;
+        stringstream stream(line);
+        string field;
+        while (getline(stream, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() < 3 || fields[0].empty() || fields[2].empty())
+            continue;
+
+        PortCacheEntry entry;
+        entry.SensorName = fields[2];
+        entry.ProbeTime = fields.size() > 3 ? atoll(fields[3].c_str()) : 0;
+        cache[fields[0] + "\t" + fields[1]] = entry;
+    }
+    return cache;
+}
+
+void InfraredSensor::save_port_cache(const map<string, PortCacheEntry> &cache)
+{
+    string path = port_cache_path();
+    if (path.empty())
+        return;
+    mkdir(path.substr(0, path.rfind('/')).c_str(), 0755); // the cache directory may not exist yet
+
+    /* The cache is only an optimisation: errors are ignored */
+    ofstream file(path, ios::trunc);
+    for (const auto &entry : cache)
+        file << entry.first << "\t" << entry.second.SensorName << "\t" << entry.second.ProbeTime << "\n";
+}
+
+void InfraredSensor::probe_ports(const vector<uint8_t> &ports, vector<string> &names, vector<uint8_t> &probed)
+{
+    /* Probe every port in its own thread, each thread writes only its own result */
+    vector<thread> probes;
+    for (uint8_t k : ports)
+        probes.emplace_back([this, k, &names, &probed]()
+                            { probed[k] = probe_port(_DeviceName.at(k), names[k]); });
+    for (thread &probe : probes)
+        probe.join();
+}
+
 /**
  * @Brief This routine inizializes the sensors attached to the Serial Ports.
  * It enumerates all the serial ports and if a compatible port is available checks
  * the presence of a Tactile or Proximity sensor reading the sensor ID.
+ * The ports are probed concurrently. The ports known from the cache to have a sensor
+ * are probed first, together with the unknown ones; the ports without a sensor (same
+ * port and same hardware ID) are skipped until their entry expires, or probed as well
+ * if no sensor answered on the other ports (i.e. a board missed the handshake once).
  */
 void InfraredSensor::init_sensor(void)
 {
@@ -181,62 +330,59 @@ void InfraredSensor::init_sensor(void)
     {
         printf("Compatible Serial Ports found on the System: %d\r\nChecking for compatible Sensor Devices...\r\n", serialPortNum);
 
+        map<string, PortCacheEntry> cache = load_port_cache();
+        int64_t now = (int64_t)time(nullptr);
+        vector<string> names(serialPortNum);
+        vector<uint8_t> probed(serialPortNum, 0U); // not vector<bool>: the threads write adjacent elements
+        vector<uint8_t> ports, skipped;
+        for (uint8_t k = 0U; k < serialPortNum; k++)
+        {
+            auto entry = cache.find(_DeviceName.at(k) + "\t" + _DeviceHardwareID.at(k));
+            if (entry != cache.end() && entry->second.SensorName == NO_SENSOR_NAME && now - entry->second.ProbeTime < PORT_CACHE_NEGATIVE_TTL_S)
+                skipped.push_back(k);
+            else
+                ports.push_back(k);
+        }
+        probe_ports(ports, names, probed);
+
+        /* No sensor on the known ports: the cached ports without a sensor may be wrong, probe them too */
+        if (none_of(names.begin(), names.end(), [](const string &name)
+                    { return !name.empty(); }))
+            probe_ports(skipped, names, probed);
+
         /* List the Device Ports */
         uint8_t sensorID = 0U;
         for (uint8_t k = 0U; k < serialPortNum; k++)
         {
-            /* Open Serial Port */
-            /* port, baudrate, timeout in milliseconds */
-            serial::Serial my_serial(_DeviceName.at(k), 1000000U, serial::Timeout::simpleTimeout(1000U));
+            string key = _DeviceName.at(k) + "\t" + _DeviceHardwareID.at(k);
+            if (probed[k])
+                cache[key] = PortCacheEntry{names[k].empty() ? NO_SENSOR_NAME : names[k], now};
+            if (names[k].empty())
+                continue;
+
+            /* Print header of sensor list */
+            if (0U == sensorID)
+            {
+                printf("\r\nDevice List:\r\n");
+                printf("### PortID [#] - Port Name ## Sensor Name ###\r\n");
+            }
 
-            /* Check if a sensor is connected to the serial port */
-            size_t bytes_wrote = my_serial.write("b");
+            /* Fill sensor information */
+            Sensor_t currentSensor;
+            currentSensor.SensorID = sensorID;
+            currentSensor.SensorName = names[k];
+            currentSensor.SerialPort = _DeviceName.at(k);
 
-            if (bytes_wrote > 0U)
-            {
-                string result = my_serial.read(4U);
+            _SensorList.push_back(currentSensor);
 
-                if (4U == result.length())
-                {
-                    /* Print header of sensor list */
-                    if (0U == sensorID)
-                    {
-                        printf("\r\nDevice List:\r\n");
-                        printf("### PortID [#] - Port Name ## Sensor Name ###\r\n");
-                    }
-                    else
-                    {
-                        ;
-                    }
-
-                    /* Fill sensor information */
-                    Sensor_t currentSensor;
-                    currentSensor.SensorID = sensorID;
-                    currentSensor.SensorName = result;
-                    currentSensor.SerialPort = _DeviceName.at(k);
-
-                    _SensorList.push_back(currentSensor);
-
-                    /* Print Device Information */
-                    printf("### [%d] - %s ## ", currentSensor.SensorID, currentSensor.SerialPort.c_str());
-                    printf("%s ###\r\n", currentSensor.SensorName.c_str());
-
-                    /* Update sensor ID count */
-                    sensorID++;
-                }
-                else
-                {
-                    ;
-                }
-            }
-            else
-            {
-                ;
-            }
+            /* Print Device Information */
+            printf("### [%d] - %s ## ", currentSensor.SensorID, currentSensor.SerialPort.c_str());
+            printf("%s ###\r\n", currentSensor.SensorName.c_str());
 
-            /* Close Serial Port */
-            my_serial.close();
+            /* Update sensor ID count */
+            sensorID++;
         }
+        save_port_cache(cache);
 
         /* If at this point sensorID == 0U, then no sensor devices have been found */
         if (0U == sensorID)
@@ -258,42 +404,26 @@ void InfraredSensor::init_sensor(void)
 void InfraredSensor::init_sensor(string SerialPortName)
 {
     uint8_t sensorID = 0U;
+    string result;
 
-    try
+    if (!probe_port(SerialPortName, result))
     {
-        /* Open Serial Port */
-        /* port, baudrate, timeout in milliseconds */
-        serial::Serial my_serial(SerialPortName, 1000000U, serial::Timeout::simpleTimeout(1000U));
-
-        /* Check if a sensor is connected to the serial port */
-        size_t bytes_wrote = my_serial.write("b");
-        string result = my_serial.read(4U);
-
-        if (4U == result.length())
-        {
-            /* Fill sensor information */
-            Sensor_t currentSensor;
-            currentSensor.SensorID = sensorID;
-            currentSensor.SensorName = result;
-            currentSensor.SerialPort = SerialPortName;
+        printf("Error: cannot open the specified Serial Port. Port syntax: /dev/ttyUSB* or /dev/ttyACM*.\r\n");
+        exit(-1);
+    }
 
-            _SensorList.push_back(currentSensor);
+    if (!result.empty())
+    {
+        /* Fill sensor information */
+        Sensor_t currentSensor;
+        currentSensor.SensorID = sensorID;
+        currentSensor.SensorName = result;
+        currentSensor.SerialPort = SerialPortName;
 
-            /* Update sensor ID count */
-            sensorID++;
-        }
-        else
-        {
-            ;
-        }
+        _SensorList.push_back(currentSensor);
 
-        /* Close Serial Port */
-        my_serial.close();
-    }
-    catch (std::exception &e)
-    {
-        printf("Error: cannot open the specified Serial Port. Port syntax: /dev/ttyUSB* or /dev/ttyACM*.\r\n");
-        exit(-1);
+        /* Update sensor ID count */
+        sensorID++;
     }
 
     /* If at this point sensorID == 0U, then no sensor devices have been found */
@@ -347,12 +477,9 @@ void InfraredSensor::select_sensor(vector<Sensor_t> sensorList, bool SerialPortS
             /* Open Serial Port */
             _SensorSerial = new serial::Serial(_SensorList.at(_SelectedSensorID).SerialPort, 1000000U, serial::Timeout::simpleTimeout(1000U));
 
-            /* Set low latency option */
-            char command[100] = {};
-            strcat(command, "setserial ");
-            strcat(command, _SensorList.at(_SelectedSensorID).SerialPort.c_str());
-            strcat(command, " low_latency");
-            system(command);
+            /* Set low latency option and read each frame with a single wake up */
+            _SensorSerial->setLowLatency();
+            _SensorSerial->setReadMode(serial::readmode_frame);
 
             /**
              * Read the number of sensing elements.
@@ -402,12 +529,9 @@ void InfraredSensor::select_sensor(vector<Sensor_t> sensorList, bool SerialPortS
             /* Open Serial Port */
             _SensorSerial = new serial::Serial(_SensorList.at(_SelectedSensorID).SerialPort, 1000000U, serial::Timeout::simpleTimeout(1000U));
 
-            /* Set low latency option */
-            char command[100] = {};
-            strcat(command, "setserial ");
-            strcat(command, _SensorList.at(_SelectedSensorID).SerialPort.c_str());
-            strcat(command, " low_latency");
-            system(command);
+            /* Set low latency option and read each frame with a single wake up */
+            _SensorSerial->setLowLatency();
+            _SensorSerial->setReadMode(serial::readmode_frame);
 
             /**
              * Read the number of sensing elements.
@@ -0,0 +1,60 @@
+#include "PigpioBackend.hpp"
+#include <pigpio.h>
+#include <stdexcept>
+
+PigpioBackend::PigpioBackend()
+{
+    if (gpioInitialise() < 0)
+        throw runtime_error("Error: pigpio initialisation failed (is the program running as root?)");
+}
+
+PigpioBackend::~PigpioBackend()
+{
+    for (auto &alert : alerts)
+        gpioSetAlertFuncEx(alert.first, nullptr, nullptr);
+}
+
+void PigpioBackend::setOutput(uint8_t pin)
+{
+    gpioSetMode(pin, PI_OUTPUT);
+}
+
+void PigpioBackend::setInput(uint8_t pin)
+{
+    gpioSetMode(pin, PI_INPUT);
+}
+
+void PigpioBackend::write(uint8_t pin, int level)
+{
+    gpioWrite(pin, level);
+}
+
+void PigpioBackend::trigger(uint8_t pin, uint32_t pulseWidth, int level)
+{
+    gpioTrigger(pin, pulseWidth, level);
+}
+
+uint32_t PigpioBackend::tick()
+{
+    return gpioTick();
+}
+
+void PigpioBackend::setAlert(uint8_t pin, GpioAlert alert)
+{
+    // the old alert is removed before changing the callback pigpio may be calling
+    gpioSetAlertFuncEx(pin, nullptr, nullptr);
+    if (!alert)
+    {
+        alerts.erase(pin);
+        return;
+    }
+    alerts[pin] = alert;
+    gpioSetAlertFuncEx(pin, onAlert, &alerts[pin]);
+}
+
+void PigpioBackend::onAlert(int gpio, int level, uint32_t tick, void *userdata)
+{
+    // level 2 is the pigpio watchdog timeout, not an edge
+    if (level == 0 || level == 1)
+        (*(GpioAlert *)userdata)(level, tick);
+}
@@ -0,0 +1,203 @@
+#include "ProximitySimulator.hpp"
+#include <stdexcept>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <chrono>
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <termios.h>
+
+#define POLL_TIMEOUT_MS 100 // period to check if the simulator has been stopped
+#define DEFAULT_DISTANCE_MM 100.0f
+#define MAX_READING_MM 255.0f // readings are sent as a single byte
+
+/*CONSTRUCTOR*/
+ProximitySimulator::ProximitySimulator(SimulatorConfig_t config)
+    : _Config(config), _Running(false), _RequestsServed(0), _Generator(random_device{}())
+{
+    if (!_Config.Profile)
+        _Config.Profile = [](double)
+        { return DEFAULT_DISTANCE_MM; };
+}
+
+ProximitySimulator::~ProximitySimulator()
+{
+    stop();
+}
+
+/*PUBLIC*/
+void ProximitySimulator::start()
+{
+    if (_Running)
+        return;
+
+    _MasterFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (_MasterFd < 0 || grantpt(_MasterFd) != 0 || unlockpt(_MasterFd) != 0)
+        throw runtime_error("Error: cannot create the pseudo terminal of the simulator");
+    _PortName = ptsname(_MasterFd);
+
+    /* Keep the slave side open, otherwise the master reads fail whenever the client closes the port */
+    _SlaveFd = open(_PortName.c_str(), O_RDWR | O_NOCTTY);
+    if (_SlaveFd < 0)
+        throw runtime_error("Error: cannot open the slave side of the simulator pseudo terminal");
+    struct termios options;
+    tcgetattr(_SlaveFd, &options);
+    cfmakeraw(&options);
+    tcsetattr(_SlaveFd, TCSANOW, &options);
+
+    _Running = true;
+    _Thread = thread(&ProximitySimulator::serve, this);
+}
+
+void ProximitySimulator::stop()
+{
+    if (!_Running)
+        return;
+
+    _Running = false;
+    _Thread.join();
+    close(_SlaveFd);
+    close(_MasterFd);
+    _SlaveFd = -1;
+    _MasterFd = -1;
+}
+
+string ProximitySimulator::getPortName()
+{
+    return _PortName;
+}
+
+uint64_t ProximitySimulator::getRequestsServed()
+{
+    return _RequestsServed;
+}
+
+DistanceProfile ProximitySimulator::parseProfile(const string &description)
+{
+    size_t pos = description.find(':');
+    string type = description.substr(0, pos);
+    vector<float> values;
+    if (pos != string::npos)
+    {
+        stringstream ss(description.substr(pos + 1));
+        string value;
+        while (getline(ss, value, ','))
+            values.push_back(stof(value));
+    }
+
+    if (type == "constant" && values.size() == 1)
+    {
+        float distance = values[0];
+        return [distance](double)
+        { return distance; };
+    }
+    if (type == "ramp" && values.size() == 3)
+    {
+        float min = values[0], max = values[1], period = values[2];
+        return [min, max, period](double t)
+        {
+            double phase = fmod(t, period) / period;
+            return (float)(min + (max - min) * (phase < 0.5 ? 2 * phase : 2 - 2 * phase));
+        };
+    }
+    if (type == "sine" && values.size() == 3)
+    {
+        float mean = values[0], amplitude = values[1], period = values[2];
+        return [mean, amplitude, period](double t)
+        { return (float)(mean + amplitude * sin(2 * M_PI * t / period)); };
+    }
+    throw invalid_argument("Unknown distance profile: " + description +
+                           " (use constant:D, ramp:MIN,MAX,PERIOD or sine:MEAN,AMPLITUDE,PERIOD)");
+}
+
+/*PRIVATE*/
+void ProximitySimulator::serve()
+{
+    auto start = chrono::steady_clock::now();
+    struct pollfd pfd = {_MasterFd, POLLIN, 0};
+    char request[64];
+
+    while (_Running)
+    {
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+            continue;
+
+        ssize_t received = read(_MasterFd, request, sizeof(request));
+        if (received <= 0)
+            continue;
+
+        for (ssize_t k = 0; k < received; k++)
+        {
+            switch (request[k])
+            {
+            case 'b':
+                answer(_Config.SensorName.substr(0, 4));
+                break;
+            case 'c':
+                answer(string(1, (char)_Config.NumSensingElements));
+                break;
+            case 'a':
+                answer(readings(chrono::duration<double>(chrono::steady_clock::now() - start).count()));
+                _RequestsServed++;
+                break;
+            default:
+                /* enable strings and unknown commands have no answer */
+                break;
+            }
+        }
+    }
+}
+
+void ProximitySimulator::answer(const string &data)
+{
+    uint32_t latency = _Config.LatencyUs;
+    if (_Config.LatencyJitterUs > 0)
+        latency += uniform_int_distribution<uint32_t>(0, _Config.LatencyJitterUs)(_Generator);
+    if (latency > 0)
+        this_thread::sleep_for(chrono::microseconds(latency));
+
+    string sent;
+    bernoulli_distribution drop(_Config.DropProbability);
+    for (char byte : data)
+    {
+        if (_Config.DropProbability <= 0 || !drop(_Generator))
+            sent.push_back(byte);
+    }
+    if (sent.empty())
+        return;
+    if (_Config.ByteTimeUs == 0)
+    {
+        write(_MasterFd, sent.data(), sent.size());
+        return;
+    }
+
+    /* Bytes paced like a real UART: spinning, a sleep is much longer than a byte time */
+    auto next = chrono::steady_clock::now();
+    for (char byte : sent)
+    {
+        while (chrono::steady_clock::now() < next)
+        {
+        }
+        write(_MasterFd, &byte, 1);
+        next += chrono::microseconds(_Config.ByteTimeUs);
+    }
+}
+
+string ProximitySimulator::readings(double elapsedSeconds)
+{
+    string data;
+    normal_distribution<float> noise(0.0f, _Config.NoiseMm);
+    float distance = _Config.Profile(elapsedSeconds);
+    for (uint8_t k = 0U; k < _Config.NumSensingElements; k++)
+    {
+        float reading = distance + (_Config.NoiseMm > 0 ? noise(_Generator) : 0.0f);
+        reading = reading < 0 ? 0 : (reading > MAX_READING_MM ? MAX_READING_MM : reading);
+        data.push_back((char)(uint8_t)lround(reading));
+    }
+    return data;
+}
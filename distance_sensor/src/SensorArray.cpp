@@ -0,0 +1,103 @@
+#include "SensorArray.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+/*CONSTRUCTOR*/
+SensorArray::~SensorArray()
+{
+    {
+        lock_guard<mutex> lock(_TickMutex);
+        _Running = false;
+    }
+    _TickCondition.notify_all();
+    for (Member *member : _Members)
+    {
+        member->worker.join();
+        delete member->sensor;
+        delete member;
+    }
+}
+
+/*PUBLIC*/
+size_t SensorArray::addSensor(DistanceSensor *sensor, const string &name, SensorSampler sampler)
+{
+    if (sensor == nullptr)
+        throw invalid_argument("Error: null sensor added to the array");
+
+    lock_guard<mutex> lock(_TickMutex);
+    size_t index = _Members.size();
+    Member *member = new Member{sensor, name, sampler, thread()};
+    _Members.push_back(member);
+    _Samples.push_back({0, -1});
+    // the worker starts from the current tick, a sample() called before it runs isn't missed
+    member->worker = thread(&SensorArray::work, this, index, _Tick);
+    return index;
+}
+
+size_t SensorArray::size()
+{
+    return _Members.size();
+}
+
+DistanceSensor &SensorArray::getSensor(size_t index)
+{
+    return *_Members.at(index)->sensor;
+}
+
+string SensorArray::getName(size_t index)
+{
+    return _Members.at(index)->name;
+}
+
+ArraySample SensorArray::sample()
+{
+    unique_lock<mutex> lock(_TickMutex);
+    _Pending = _Members.size();
+    _Tick++;
+    _TickCondition.notify_all();
+    _DoneCondition.wait(lock, [this]
+                        { return _Pending == 0; });
+
+    ArraySample joined;
+    joined.samples = _Samples;
+    joined.timestamp_ns = 0;
+    joined.skew_ns = 0;
+    if (joined.samples.empty())
+        return joined;
+
+    /* mean computed on the offsets from the first sample to avoid overflows */
+    int64_t first = joined.samples[0].timestamp_ns, offsets = 0, earliest = first, latest = first;
+    for (const DistanceSample &sample : joined.samples)
+    {
+        offsets += sample.timestamp_ns - first;
+        earliest = min(earliest, sample.timestamp_ns);
+        latest = max(latest, sample.timestamp_ns);
+    }
+    joined.timestamp_ns = first + offsets / (int64_t)joined.samples.size();
+    joined.skew_ns = latest - earliest;
+    return joined;
+}
+
+/*PRIVATE*/
+void SensorArray::work(size_t index, uint64_t served)
+{
+    unique_lock<mutex> lock(_TickMutex);
+    Member *member = _Members[index];
+    while (true)
+    {
+        _TickCondition.wait(lock, [&]
+                            { return _Tick != served || !_Running; });
+        if (!_Running)
+            return;
+        served = _Tick;
+
+        lock.unlock();
+        DistanceSample sample = member->sampler ? member->sampler(*member->sensor)
+                                                : member->sensor->sampleInMillimeters();
+        lock.lock();
+
+        _Samples[index] = sample;
+        if (--_Pending == 0)
+            _DoneCondition.notify_one();
+    }
+}
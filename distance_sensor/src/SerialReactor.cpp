@@ -0,0 +1,118 @@
+#include "SerialReactor.hpp"
+#include "Timebase.hpp"
+#include <stdexcept>
+#include <cstring>
+
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/epoll.h>
+
+#define MAX_EVENTS 16
+
+SerialReactor::SerialReactor()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0)
+        throw runtime_error(string("Error: cannot create the epoll instance: ") + strerror(errno));
+}
+
+SerialReactor::~SerialReactor()
+{
+    close(epollFd);
+}
+
+size_t SerialReactor::addSensor(serial::Serial *port, const string &request, size_t frameLength, FrameCallback callback)
+{
+    Channel channel;
+    channel.port = port;
+    channel.fd = port->getNativeHandle();
+    channel.request = request;
+    channel.frameLength = frameLength;
+    channel.callback = callback;
+    channel.buffer.reserve(frameLength);
+    channel.pending = false;
+    channel.request_ns = 0;
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = channels.size();
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, channel.fd, &event) < 0)
+        throw runtime_error("Error: cannot add " + port->getPort() + " to epoll: " + strerror(errno));
+
+    channels.push_back(channel);
+    return channels.size() - 1;
+}
+
+size_t SerialReactor::sample(int timeout_ms)
+{
+    size_t pending = 0, completed = 0;
+
+    /* All the requests first, so the sensors answer in parallel */
+    for (Channel &channel : channels)
+    {
+        channel.buffer.clear();
+        channel.request_ns = timebase::now();
+        ssize_t written = ::write(channel.fd, channel.request.data(), channel.request.size());
+        channel.pending = written == (ssize_t)channel.request.size();
+        if (channel.pending)
+            pending++;
+        else
+            lostFrames++;
+    }
+
+    /* Then the answers, as their bytes arrive */
+    int64_t deadline = timebase::now() + (int64_t)timeout_ms * 1000000;
+    struct epoll_event events[MAX_EVENTS];
+    while (pending > 0)
+    {
+        int64_t remaining_ns = deadline - timebase::now();
+        if (remaining_ns <= 0)
+            break;
+
+        int count = epoll_wait(epollFd, events, MAX_EVENTS, (int)((remaining_ns + 999999) / 1000000));
+        if (count < 0 && errno != EINTR)
+            throw runtime_error(string("Error: epoll_wait failed: ") + strerror(errno));
+
+        for (int k = 0; k < count; k++)
+        {
+            Channel &channel = channels[events[k].data.u64];
+            uint8_t bytes[256];
+            size_t missing = channel.pending ? channel.frameLength - channel.buffer.size() : sizeof(bytes);
+            ssize_t received = ::read(channel.fd, bytes, missing < sizeof(bytes) ? missing : sizeof(bytes));
+            if (received <= 0 || !channel.pending)
+                continue; // late bytes of a discarded frame are dropped
+
+            channel.buffer.insert(channel.buffer.end(), bytes, bytes + received);
+            if (channel.buffer.size() < channel.frameLength)
+                continue;
+
+            channel.pending = false;
+            pending--;
+            completed++;
+            channel.callback({events[k].data.u64, channel.buffer, channel.request_ns, timebase::now()});
+        }
+    }
+
+    /* Incomplete frames: the stale bytes would shift the next frame */
+    for (Channel &channel : channels)
+    {
+        if (!channel.pending)
+            continue;
+        channel.pending = false;
+        tcflush(channel.fd, TCIFLUSH);
+        lostFrames++;
+    }
+    return completed;
+}
+
+size_t SerialReactor::size()
+{
+    return channels.size();
+}
+
+uint64_t SerialReactor::getLostFrames()
+{
+    return lostFrames;
+}
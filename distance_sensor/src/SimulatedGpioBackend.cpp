@@ -0,0 +1,95 @@
+#include "SimulatedGpioBackend.hpp"
+
+#define SIM_SOUND_SPEED_MS 343
+#define SIM_ECHO_DELAY_US 450     // time from the end of the trigger to the rising edge of the echo
+#define SIM_MAX_RANGE_MM 4000.0f  // no echo beyond this distance
+#define SIM_DEFAULT_DISTANCE_MM 100.0f
+
+SimulatedGpioBackend::SimulatedGpioBackend(DistanceProfile profile, float noiseMm)
+    : profile(profile), noiseMm(noiseMm), start(chrono::steady_clock::now()), generator(random_device{}())
+{
+    if (!this->profile)
+        this->profile = [](double)
+        { return SIM_DEFAULT_DISTANCE_MM; };
+    echoGenerator = thread(&SimulatedGpioBackend::generateEchoes, this);
+}
+
+SimulatedGpioBackend::~SimulatedGpioBackend()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        running = false;
+    }
+    triggered.notify_one();
+    echoGenerator.join();
+}
+
+void SimulatedGpioBackend::setOutput(uint8_t pin)
+{
+}
+
+void SimulatedGpioBackend::setInput(uint8_t pin)
+{
+}
+
+void SimulatedGpioBackend::write(uint8_t pin, int level)
+{
+}
+
+void SimulatedGpioBackend::trigger(uint8_t pin, uint32_t pulseWidth, int level)
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        pendingTrigger = true;
+        triggerTick = tick() + pulseWidth;
+    }
+    triggered.notify_one();
+}
+
+uint32_t SimulatedGpioBackend::tick()
+{
+    return (uint32_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void SimulatedGpioBackend::setAlert(uint8_t pin, GpioAlert alert)
+{
+    lock_guard<mutex> lock(mtx);
+    if (alert)
+        alerts[pin] = alert;
+    else
+        alerts.erase(pin);
+}
+
+/*PRIVATE*/
+void SimulatedGpioBackend::generateEchoes()
+{
+    unique_lock<mutex> lock(mtx);
+    while (running)
+    {
+        triggered.wait(lock, [this]
+                       { return pendingTrigger || !running; });
+        if (!running)
+            break;
+        pendingTrigger = false;
+
+        float distance = profile(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        if (noiseMm > 0)
+            distance += normal_distribution<float>(0.0f, noiseMm)(generator);
+        if (distance < 0 || distance > SIM_MAX_RANGE_MM)
+            continue;
+
+        uint32_t rise = triggerTick + SIM_ECHO_DELAY_US;
+        uint32_t width = (uint32_t)(distance / 1000.0 * 2.0 / SIM_SOUND_SPEED_MS * 1000000.0);
+        map<uint8_t, GpioAlert> echoAlerts = alerts;
+
+        // the alerts are called without the lock, like the callbacks of a real backend thread
+        lock.unlock();
+        this_thread::sleep_until(start + chrono::microseconds(rise));
+        for (auto &alert : echoAlerts)
+            alert.second(1, rise);
+        this_thread::sleep_until(start + chrono::microseconds(rise + width));
+        for (auto &alert : echoAlerts)
+            alert.second(0, rise + width);
+        lock.lock();
+    }
+}
@@ -1,17 +1,30 @@
 #include "DistanceSensor.hpp"
 #include "UltrasonicSensor.hpp"
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 /*CONSTRUCTOR*/
 UltrasonicSensor::UltrasonicSensor(
     uint8_t attachedTrigPin,
-    uint8_t attachedEchoPin)
+    uint8_t attachedEchoPin,
+    GpioBackend *gpio)
     : attachedTrigPin(attachedTrigPin),
-      attachedEchoPin(attachedEchoPin)
+      attachedEchoPin(attachedEchoPin),
+      gpio(gpio != nullptr ? gpio : GpioBackend::create()),
+      scheduling(false)
 {
-    gpioInitialise();
     _maxEchoTime = (unsigned int)MAX_SENSOR_DISTANCE_CM * US_ROUNDTRIP_CM; // tempo massimo di attesa echo in micro-secondi us
-    gpioSetMode(attachedTrigPin, PI_OUTPUT);
-    gpioSetMode(attachedEchoPin, PI_INPUT);
+    this->gpio->setOutput(attachedTrigPin);
+    this->gpio->setInput(attachedEchoPin);
+    this->gpio->write(attachedTrigPin, 0);
+    tickClock = new timebase::TickClock([this]
+                                        { return this->gpio->tick(); });
+
+    // i fronti dell'echo arrivano con il tick hardware, senza polling del pin
+    this->gpio->setAlert(attachedEchoPin, [this](int level, uint32_t tick)
+                         { echoAlert(level, tick); });
 
     /*!!!!!!!!!!!!!!!!aggiunta carica curva di calibrazione...
         calibrationLine. m = ...
@@ -19,60 +32,243 @@ UltrasonicSensor::UltrasonicSensor(
     */
 }
 
+UltrasonicSensor::~UltrasonicSensor()
+{
+    stopPinging();
+    gpio->setAlert(attachedEchoPin, nullptr);
+    delete tickClock;
+    delete gpio;
+}
+
 /*PUBLIC METHODS*/
 /*IMPORTANT: Returns -1 if the sensor timed out else it returns the correct distance*/
 float UltrasonicSensor::getDistanceInMeters()
 {
-    gpioWrite(attachedTrigPin, 0);
+    if (scheduling)
+    {
+        DistanceSample sample = next();
+        return sample.distance_mm < 0 ? -1 : sample.distance_mm / 1000;
+    }
 
-    // Invia un impulso di trigger di durata TRIGGER_WIDTH
-    gpioTrigger(attachedTrigPin, TRIGGER_WIDTH, 1);
-    // calcolo il massimo valore di attesa per l'ecbo
-    unsigned long _max_time = gpioTick() + _maxEchoTime + MAX_SENSOR_DELAY;
+    std::lock_guard<std::mutex> lock(pingMutex);
+    uint32_t echoTick;
+    return ping(echoTick);
+}
 
-    // attendo che il pin di echo si alzi
-    while (!gpioRead(attachedEchoPin) && gpioTick() < _max_time)
+float UltrasonicSensor::getDistanceInCentimeters()
+{
+    return getDistanceInMeters() * 100;
+}
+float UltrasonicSensor::getDistanceInMillimeters()
+{
+    return getDistanceInMeters() * 1000;
+}
+
+void UltrasonicSensor::useCalibrationCurve(float m, float q)
+{
+    m_cal = m;
+    q_cal = q;
+    calibrationEnabled = true;
+}
+
+DistanceSample UltrasonicSensor::sampleInMillimeters()
+{
+    return next();
+}
+
+void UltrasonicSensor::startPinging(unsigned int period_ms)
+{
+    if (scheduling)
+        return;
+    scheduling = true;
+    scheduler = std::thread(&UltrasonicSensor::schedulePings, this, period_ms);
+}
+
+void UltrasonicSensor::stopPinging()
+{
+    if (!scheduling)
+        return;
+    scheduling = false;
+    scheduler.join();
     {
+        // taking the lock avoids a lost wake up of next() between its check and its wait
+        std::lock_guard<std::mutex> lock(sampleMutex);
     }
+    sampleCondition.notify_all();
+}
+
+DistanceSample UltrasonicSensor::latest()
+{
+    std::lock_guard<std::mutex> lock(sampleMutex);
+    return latestSample;
+}
+
+DistanceSample UltrasonicSensor::next()
+{
+    if (!scheduling)
+        return pingSample();
 
-    if (gpioTick() >= _max_time)
+    std::unique_lock<std::mutex> lock(sampleMutex);
+    uint64_t current = sampleCount;
+    sampleCondition.wait(lock, [&]
+                         { return sampleCount != current || !scheduling; });
+    return latestSample;
+}
+
+unsigned int UltrasonicSensor::burstPeriodUs()
+{
+    return TRIGGER_WIDTH + MAX_SENSOR_DELAY + 2 * _maxEchoTime;
+}
+
+BurstEstimate UltrasonicSensor::burst(unsigned int pings)
+{
+    BurstEstimate estimate = {timebase::now(), -1, 0, 0, 0, 0, 0};
+    std::vector<DistanceSample> echoes;
+
+    // ping a cadenza fissa, scartando i time out
+    auto period = std::chrono::microseconds(burstPeriodUs());
+    auto next_ping = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < pings; i++)
     {
-        // se il tempo trascorso supera il valore massimo vado in time out
-        return -1;
+        DistanceSample sample = pingSample();
+        if (sample.distance_mm < 0)
+            estimate.timeouts++;
+        else
+            echoes.push_back(sample);
+
+        next_ping += period;
+        if (i + 1 < pings)
+            std::this_thread::sleep_until(next_ping);
+    }
+
+    // mediana mobile centrata: scarto gli echi lontani dalla mediana dei vicini
+    double sum = 0, sum_squares = 0, sum_time = 0;
+    for (size_t i = 0; i < echoes.size(); i++)
+    {
+        size_t half = BURST_MEDIAN_WINDOW / 2;
+        size_t first = i > half ? i - half : 0;
+        size_t last = std::min(echoes.size(), first + BURST_MEDIAN_WINDOW);
+        first = last > BURST_MEDIAN_WINDOW ? last - BURST_MEDIAN_WINDOW : 0;
+
+        std::vector<float> window;
+        for (size_t k = first; k < last; k++)
+            window.push_back(echoes[k].distance_mm);
+        std::nth_element(window.begin(), window.begin() + window.size() / 2, window.end());
+        float median = window[window.size() / 2];
+
+        if (std::abs(echoes[i].distance_mm - median) > BURST_OUTLIER_MM)
+        {
+            estimate.outliers++;
+            continue;
+        }
+        estimate.accepted++;
+        sum += echoes[i].distance_mm;
+        sum_squares += echoes[i].distance_mm * echoes[i].distance_mm;
+        sum_time += echoes[i].timestamp_ns - estimate.timestamp_ns;
+    }
+
+    if (estimate.accepted > 0)
+    {
+        double mean = sum / estimate.accepted;
+        double variance = estimate.accepted > 1 ? (sum_squares - estimate.accepted * mean * mean) / (estimate.accepted - 1) : 0;
+        estimate.distance_mm = mean;
+        estimate.variance_mm2 = variance > 0 ? variance : 0;
+        estimate.estimate_variance_mm2 = estimate.variance_mm2 / estimate.accepted;
+        estimate.timestamp_ns += (int64_t)(sum_time / estimate.accepted);
+    }
+    return estimate;
+}
+
+/*PRIVATE METHODS*/
+void UltrasonicSensor::echoAlert(int level, uint32_t tick)
+{
+    std::lock_guard<std::mutex> lock(echoMutex);
+
+    // ignora i fronti fuori da un ping (es. echo di un ping andato in time out)
+    if (!waitingEcho)
+        return;
+
+    if (level == 1)
+    {
+        riseTick = tick;
+        riseSeen = true;
+    }
+    else if (level == 0 && riseSeen)
+    {
+        echoWidth = tick - riseTick;
+        echoDone = true;
+        waitingEcho = false;
+        echoCondition.notify_one();
     }
-    uint32_t tempo = gpioTick();
-    while (gpioRead(attachedEchoPin))
+}
+
+float UltrasonicSensor::ping(uint32_t &echoTick)
+{
+    std::unique_lock<std::mutex> lock(echoMutex);
+    riseSeen = false;
+    echoDone = false;
+    waitingEcho = true;
+    lock.unlock();
+
+    // Invia un impulso di trigger di durata TRIGGER_WIDTH
+    gpio->trigger(attachedTrigPin, TRIGGER_WIDTH, 1);
+
+    // attendo la fine dell'echo al massimo per il tempo di avvio del ping, di volo e di consegna dei fronti
+    lock.lock();
+    bool received = echoCondition.wait_for(lock, std::chrono::microseconds(TRIGGER_WIDTH + MAX_SENSOR_DELAY + _maxEchoTime + ALERT_LATENCY), [&]
+                                           { return echoDone; });
+    waitingEcho = false;
+    if (!received)
     {
+        // se il tempo trascorso supera il valore massimo vado in time out
+        return -1;
     }
 
-    // calcolo il tempo trascorso tra trigger e ricezione di echo (ping time)
-    uint32_t elapsed_time = gpioTick() - tempo;
+    // tempo tra i fronti di salita e discesa dell'echo (ping time)
+    uint32_t elapsed_time = echoWidth;
+    echoTick = riseTick + elapsed_time / 2;
+    lock.unlock();
+
     // calcolo la distanza in base al tempo trascorso
     float distance = elapsed_time / 1000000.0 * SOUND_SPEED_MS / 2.0;
 
-    /*ritorno la misura calibrata o non calibrata*/
+    /*ritorno la misura calibrata o non calibrata, la retta di calibrazione e' in millimetri*/
     if (calibrationEnabled)
-        return getCalibratedDistance(distance);
+        return getCalibratedDistance(distance * 1000) / 1000;
     else
         return distance;
 }
-float UltrasonicSensor::getDistanceInCentimeters()
-{
-    return getDistanceInMeters() * 100;
-}
-float UltrasonicSensor::getDistanceInMillimeters()
+
+DistanceSample UltrasonicSensor::pingSample()
 {
-    return getDistanceInMeters() * 1000;
+    std::lock_guard<std::mutex> lock(pingMutex);
+    DistanceSample sample;
+    uint32_t echoTick;
+    float distance = ping(echoTick);
+    sample.distance_mm = distance < 0 ? -1 : distance * 1000;
+    sample.timestamp_ns = distance < 0 ? timebase::now() : tickClock->toTimeline(echoTick);
+    return sample;
 }
 
-void UltrasonicSensor::useCalibrationCurve(float m, float q)
+void UltrasonicSensor::schedulePings(unsigned int period_ms)
 {
-    m_cal = m;
-    q_cal = q;
-    calibrationEnabled = true;
+    auto period = std::chrono::milliseconds(period_ms);
+    auto next_ping = std::chrono::steady_clock::now();
+    while (scheduling)
+    {
+        DistanceSample sample = pingSample();
+        {
+            std::lock_guard<std::mutex> lock(sampleMutex);
+            latestSample = sample;
+            sampleCount++;
+        }
+        sampleCondition.notify_all();
+
+        next_ping += period;
+        std::this_thread::sleep_until(next_ping);
+    }
 }
 
-/*PRIVATE METHODS*/
 float UltrasonicSensor::getCalibratedDistance(float spoiltMeasure)
 {
     return (spoiltMeasure - q_cal) / m_cal;
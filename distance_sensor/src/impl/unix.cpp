@@ -24,6 +24,8 @@
 #endif
 
 #include <sys/select.h>
+#include <poll.h>
+#include <algorithm>
 #include <sys/time.h>
 #include <time.h>
 #ifdef __MACH__
@@ -111,7 +113,8 @@ Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 flowcontrol_t flowcontrol)
   : port_ (port), fd_ (-1), is_open_ (false), xonxoff_ (false), rtscts_ (false),
     baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    readmode_ (readmode_select), vmin_ (0)
 {
   pthread_mutex_init(&this->read_mutex, NULL);
   pthread_mutex_init(&this->write_mutex, NULL);
@@ -439,6 +442,7 @@ Serial::SerialImpl::reconfigurePort ()
   // to read before each call, so we should never needlessly poll
   options.c_cc[VMIN] = 0;
   options.c_cc[VTIME] = 0;
+  vmin_ = 0;
 
   // activate settings
   ::tcsetattr (fd_, TCSANOW, &options);
@@ -536,6 +540,9 @@ Serial::SerialImpl::read (uint8_t *buf, size_t size)
   if (!is_open_) {
     throw PortNotOpenedException ("Serial::read");
   }
+  if (readmode_ == readmode_frame) {
+    return readFrame (buf, size);
+  }
   size_t bytes_read = 0;
 
   // Calculate total timeout in milliseconds t_c + (t_m * N)
@@ -706,6 +713,15 @@ Serial::SerialImpl::getPort () const
   return port_;
 }
 
+int
+Serial::SerialImpl::getNativeHandle () const
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::getNativeHandle");
+  }
+  return fd_;
+}
+
 void
 Serial::SerialImpl::setTimeout (serial::Timeout &timeout)
 {
@@ -788,6 +804,85 @@ Serial::SerialImpl::getFlowcontrol () const
   return flowcontrol_;
 }
 
+void
+Serial::SerialImpl::setReadMode (readmode_t readmode)
+{
+  readmode_ = readmode;
+  if (readmode_ == readmode_select && is_open_) {
+    setVmin (0);
+  }
+}
+
+serial::readmode_t
+Serial::SerialImpl::getReadMode () const
+{
+  return readmode_;
+}
+
+void
+Serial::SerialImpl::setVmin (size_t count)
+{
+  // VMIN is a byte: bigger frames wake up at 255 bytes and loop
+  cc_t vmin = static_cast<cc_t> (std::min (count, static_cast<size_t> (255)));
+  if (vmin == vmin_) {
+    return;
+  }
+  struct termios options;
+  if (tcgetattr (fd_, &options) == -1) {
+    THROW (IOException, "::tcgetattr");
+  }
+  options.c_cc[VMIN] = vmin;
+  options.c_cc[VTIME] = 0;
+  if (tcsetattr (fd_, TCSANOW, &options) == -1) {
+    THROW (IOException, "::tcsetattr");
+  }
+  vmin_ = vmin;
+}
+
+size_t
+Serial::SerialImpl::readFrame (uint8_t *buf, size_t size)
+{
+  // With VMIN = size and VTIME = 0 the line discipline reports the port
+  // readable only when the whole frame is buffered: one poll, one read.
+  // The descriptor is non blocking, so read never waits for VMIN bytes.
+  size_t bytes_read = 0;
+  long total_timeout_ms = timeout_.read_timeout_constant;
+  total_timeout_ms += timeout_.read_timeout_multiplier * static_cast<long> (size);
+  MillisecondTimer total_timeout(total_timeout_ms);
+
+  while (bytes_read < size) {
+    setVmin (size - bytes_read);
+
+    int64_t timeout_remaining_ms = total_timeout.remaining();
+    if (timeout_remaining_ms <= 0) {
+      break;
+    }
+    struct pollfd pfd = {fd_, POLLIN, 0};
+    int r = ::poll (&pfd, 1, static_cast<int> (timeout_remaining_ms));
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      THROW (IOException, errno);
+    }
+    if (r == 0) {
+      // Timed out: return the bytes received so far, like readmode_select
+      ssize_t bytes_read_now = ::read (fd_, buf + bytes_read, size - bytes_read);
+      if (bytes_read_now > 0) {
+        bytes_read += static_cast<size_t> (bytes_read_now);
+      }
+      break;
+    }
+    ssize_t bytes_read_now = ::read (fd_, buf + bytes_read, size - bytes_read);
+    if (bytes_read_now < 1) {
+      throw SerialException ("device reports readiness to read but "
+                             "returned no data (device disconnected?)");
+    }
+    bytes_read += static_cast<size_t> (bytes_read_now);
+  }
+  return bytes_read;
+}
+
 void
 Serial::SerialImpl::flush ()
 {
@@ -824,6 +919,32 @@ Serial::SerialImpl::sendBreak (int duration)
   tcsendbreak (fd_, static_cast<int> (duration / 4));
 }
 
+bool
+Serial::SerialImpl::setLowLatency (bool enabled)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException ("Serial::setLowLatency");
+  }
+#if defined(__linux__) && defined (TIOCSSERIAL) && defined (ASYNC_LOW_LATENCY)
+  struct serial_struct ser;
+
+  if (-1 == ioctl (fd_, TIOCGSERIAL, &ser)) {
+    return false;
+  }
+
+  if (enabled) {
+    ser.flags |= ASYNC_LOW_LATENCY;
+  } else {
+    ser.flags &= ~ASYNC_LOW_LATENCY;
+  }
+
+  return -1 != ioctl (fd_, TIOCSSERIAL, &ser);
+#else
+  (void)enabled;
+  return false;
+#endif
+}
+
 void
 Serial::SerialImpl::setBreak (bool level)
 {
@@ -16,6 +16,7 @@ using serial::bytesize_t;
 using serial::parity_t;
 using serial::stopbits_t;
 using serial::flowcontrol_t;
+using serial::readmode_t;
 using serial::SerialException;
 using serial::PortNotOpenedException;
 using serial::IOException;
@@ -37,7 +38,8 @@ Serial::SerialImpl::SerialImpl (const string &port, unsigned long baudrate,
                                 flowcontrol_t flowcontrol)
   : port_ (port.begin(), port.end()), fd_ (INVALID_HANDLE_VALUE), is_open_ (false),
     baudrate_ (baudrate), parity_ (parity),
-    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol)
+    bytesize_ (bytesize), stopbits_ (stopbits), flowcontrol_ (flowcontrol),
+    readmode_ (readmode_select)
 {
   if (port_.empty () == false)
     open ();
@@ -459,6 +461,19 @@ Serial::SerialImpl::getFlowcontrol () const
   return flowcontrol_;
 }
 
+void
+Serial::SerialImpl::setReadMode (readmode_t readmode)
+{
+  // Windows has no VMIN: the read strategy is always readmode_select
+  readmode_ = readmode;
+}
+
+readmode_t
+Serial::SerialImpl::getReadMode () const
+{
+  return readmode_;
+}
+
 void
 Serial::SerialImpl::flush ()
 {
@@ -492,6 +507,17 @@ Serial::SerialImpl::sendBreak (int /*duration*/)
   THROW (IOException, "sendBreak is not supported on Windows.");
 }
 
+bool
+Serial::SerialImpl::setLowLatency (bool enabled)
+{
+  if (is_open_ == false) {
+    throw PortNotOpenedException("Serial::setLowLatency");
+  }
+  // The latency timer of the USB-serial adapters is a driver setting on Windows
+  (void)enabled;
+  return false;
+}
+
 void
 Serial::SerialImpl::setBreak (bool level)
 {
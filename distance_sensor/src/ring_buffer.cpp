@@ -0,0 +1,123 @@
+/* Buffer of the bytes read ahead by Serial::readline */
+#include <algorithm>
+#include <cstring>
+
+#include "serial/ring_buffer.h"
+
+using serial::RingBuffer;
+using std::min;
+using std::string;
+
+RingBuffer::RingBuffer (size_t capacity)
+  : data_ (capacity), head_ (0), size_ (0)
+{
+}
+
+size_t
+RingBuffer::size () const
+{
+  return size_;
+}
+
+bool
+RingBuffer::empty () const
+{
+  return size_ == 0;
+}
+
+uint8_t *
+RingBuffer::reserve (size_t &length)
+{
+  if (size_ == 0) {
+    head_ = 0;
+  }
+  if (size_ == data_.size ()) {
+    // Full: a line longer than the buffer, double it
+    linearise ();
+    data_.resize (data_.size () * 2);
+  }
+  size_t tail = (head_ + size_) % data_.size ();
+  length = tail < head_ ? head_ - tail : data_.size () - tail;
+  return &data_[tail];
+}
+
+void
+RingBuffer::commit (size_t length)
+{
+  size_ += length;
+}
+
+size_t
+RingBuffer::find (const string &eol, size_t limit, size_t &scanned)
+{
+  if (eol.empty () || size_ == 0) {
+    return 0;
+  }
+  linearise ();
+  size_t end = min (size_, limit);
+  const uint8_t *begin = &data_[head_];
+
+  while (scanned + eol.length () <= end) {
+    const void *match = memchr (begin + scanned, eol[0], end - scanned);
+    if (match == NULL) {
+      scanned = end;
+      break;
+    }
+    size_t position = static_cast<const uint8_t *> (match) - begin;
+    if (position + eol.length () > end) {
+      // Possibly the start of an eol not fully received yet
+      scanned = position;
+      break;
+    }
+    if (memcmp (begin + position, eol.data (), eol.length ()) == 0) {
+      scanned = 0;
+      return position + eol.length ();
+    }
+    scanned = position + 1;
+  }
+  return 0;
+}
+
+const uint8_t *
+RingBuffer::data ()
+{
+  linearise ();
+  return &data_[head_];
+}
+
+void
+RingBuffer::consume (size_t length)
+{
+  length = min (length, size_);
+  head_ = (head_ + length) % data_.size ();
+  size_ -= length;
+}
+
+size_t
+RingBuffer::take (uint8_t *buffer, size_t length)
+{
+  length = min (length, size_);
+  size_t first = min (length, data_.size () - head_);
+  memcpy (buffer, &data_[head_], first);
+  memcpy (buffer + first, &data_[0], length - first);
+  consume (length);
+  return length;
+}
+
+void
+RingBuffer::clear ()
+{
+  head_ = 0;
+  size_ = 0;
+}
+
+void
+RingBuffer::linearise ()
+{
+  // Only needed when the data wraps around the end of the storage
+  if (head_ + size_ <= data_.size ()) {
+    return;
+  }
+  std::rotate (data_.begin (), data_.begin () + head_, data_.end ());
+  head_ = 0;
+}
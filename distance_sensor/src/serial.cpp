@@ -1,14 +1,6 @@
 /* Copyright 2012 William Woodall and John Harrison */
 #include <algorithm>
 
-#if !defined(_WIN32) && !defined(__OpenBSD__) && !defined(__FreeBSD__)
-# include <alloca.h>
-#endif
-
-#if defined (__MINGW32__)
-# define alloca __builtin_alloca
-#endif
-
 #include "serial/serial.h"
 
 #ifdef _WIN32
@@ -18,6 +10,7 @@
 #endif
 
 using std::invalid_argument;
+using std::max;
 using std::min;
 using std::numeric_limits;
 using std::vector;
@@ -31,6 +24,7 @@ using serial::bytesize_t;
 using serial::parity_t;
 using serial::stopbits_t;
 using serial::flowcontrol_t;
+using serial::readmode_t;
 
 class Serial::ScopedReadLock {
 public:
@@ -98,12 +92,15 @@ Serial::isOpen () const
 size_t
 Serial::available ()
 {
-  return pimpl_->available ();
+  return read_buffer_.size () + pimpl_->available ();
 }
 
 bool
 Serial::waitReadable ()
 {
+  if (!read_buffer_.empty ()) {
+    return true;
+  }
   serial::Timeout timeout(pimpl_->getTimeout ());
   return pimpl_->waitReadable(timeout.read_timeout_constant);
 }
@@ -117,14 +114,18 @@ Serial::waitByteTimes (size_t count)
 size_t
 Serial::read_ (uint8_t *buffer, size_t size)
 {
-  return this->pimpl_->read (buffer, size);
+  size_t buffered = read_buffer_.take (buffer, size);
+  if (buffered == size) {
+    return size;
+  }
+  return buffered + this->pimpl_->read (buffer + buffered, size - buffered);
 }
 
 size_t
 Serial::read (uint8_t *buffer, size_t size)
 {
   ScopedReadLock lock(this->pimpl_);
-  return this->pimpl_->read (buffer, size);
+  return this->read_ (buffer, size);
 }
 
 size_t
@@ -135,7 +136,7 @@ Serial::read (std::vector<uint8_t> &buffer, size_t size)
   size_t bytes_read = 0;
 
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (buffer_, size);
   }
   catch (const std::exception &e) {
     delete[] buffer_;
@@ -154,7 +155,7 @@ Serial::read (std::string &buffer, size_t size)
   uint8_t *buffer_ = new uint8_t[size];
   size_t bytes_read = 0;
   try {
-    bytes_read = this->pimpl_->read (buffer_, size);
+    bytes_read = this->read_ (buffer_, size);
   }
   catch (const std::exception &e) {
     delete[] buffer_;
@@ -174,32 +175,52 @@ Serial::read (size_t size)
 }
 
 size_t
-Serial::readline (string &buffer, size_t size, string eol)
+Serial::bufferLine_ (size_t size, const string &eol)
 {
-  ScopedReadLock lock(this->pimpl_);
-  size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-                              (alloca (size * sizeof (uint8_t)));
-  size_t read_so_far = 0;
+  size_t scanned = 0;
   while (true)
   {
-    size_t bytes_read = this->read_ (buffer_ + read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
-      break; // Timeout occured on reading 1 byte
+    size_t line_length = read_buffer_.find (eol, size, scanned);
+    if (line_length > 0) {
+      return line_length; // EOL found
     }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      break; // EOL found
+    if (read_buffer_.size () >= size) {
+      return size; // Reached the maximum read length
     }
-    if (read_so_far == size) {
-      break; // Reached the maximum read length
+    // Read what is available (at least one byte) in a single call
+    size_t space;
+    uint8_t *chunk = read_buffer_.reserve (space);
+    size_t wanted = max (static_cast<size_t> (1), pimpl_->available ());
+    size_t bytes_read = this->pimpl_->read (chunk, min (wanted, space));
+    read_buffer_.commit (bytes_read);
+    if (bytes_read == 0) {
+      return min (read_buffer_.size (), size); // Timeout occured
     }
   }
-  buffer.append(reinterpret_cast<const char*> (buffer_), read_so_far);
+}
+
+size_t
+Serial::readline (string &buffer, size_t size, string eol)
+{
+  ScopedReadLock lock(this->pimpl_);
+  size_t read_so_far = bufferLine_ (size, eol);
+  buffer.append (reinterpret_cast<const char*> (read_buffer_.data ()), read_so_far);
+  read_buffer_.consume (read_so_far);
   return read_so_far;
 }
 
+#if __cplusplus >= 201703L
+size_t
+Serial::readline (std::string_view &line, size_t size, string eol)
+{
+  ScopedReadLock lock(this->pimpl_);
+  size_t read_so_far = bufferLine_ (size, eol);
+  line = std::string_view (reinterpret_cast<const char*> (read_buffer_.data ()), read_so_far);
+  read_buffer_.consume (read_so_far);
+  return read_so_far;
+}
+#endif
+
 string
 Serial::readline (size_t size, string eol)
 {
@@ -213,37 +234,17 @@ Serial::readlines (size_t size, string eol)
 {
   ScopedReadLock lock(this->pimpl_);
   std::vector<std::string> lines;
-  size_t eol_len = eol.length ();
-  uint8_t *buffer_ = static_cast<uint8_t*>
-    (alloca (size * sizeof (uint8_t)));
   size_t read_so_far = 0;
-  size_t start_of_line = 0;
   while (read_so_far < size) {
-    size_t bytes_read = this->read_ (buffer_+read_so_far, 1);
-    read_so_far += bytes_read;
-    if (bytes_read == 0) {
-      if (start_of_line != read_so_far) {
-        lines.push_back (
-          string (reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
-      break; // Timeout occured on reading 1 byte
-    }
-    if (string (reinterpret_cast<const char*>
-         (buffer_ + read_so_far - eol_len), eol_len) == eol) {
-      // EOL found
-      lines.push_back(
-        string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-          read_so_far - start_of_line));
-      start_of_line = read_so_far;
+    size_t line_length = bufferLine_ (size - read_so_far, eol);
+    if (line_length > 0) {
+      lines.push_back (
+        string (reinterpret_cast<const char*> (read_buffer_.data ()), line_length));
+      read_buffer_.consume (line_length);
+      read_so_far += line_length;
     }
-    if (read_so_far == size) {
-      if (start_of_line != read_so_far) {
-        lines.push_back(
-          string(reinterpret_cast<const char*> (buffer_ + start_of_line),
-            read_so_far - start_of_line));
-      }
-      break; // Reached the maximum read length
+    if (line_length == 0 || lines.back ().compare (lines.back ().size () - min (eol.size (), lines.back ().size ()), string::npos, eol) != 0) {
+      break; // Timeout occured or reached the maximum read length
     }
   }
   return lines;
@@ -294,6 +295,14 @@ Serial::getPort () const
   return pimpl_->getPort ();
 }
 
+#if !defined(_WIN32)
+int
+Serial::getNativeHandle () const
+{
+  return pimpl_->getNativeHandle ();
+}
+#endif
+
 void
 Serial::setTimeout (serial::Timeout &timeout)
 {
@@ -365,16 +374,31 @@ Serial::getFlowcontrol () const
   return pimpl_->getFlowcontrol ();
 }
 
+void
+Serial::setReadMode (readmode_t readmode)
+{
+  ScopedReadLock lock(this->pimpl_);
+  pimpl_->setReadMode (readmode);
+}
+
+readmode_t
+Serial::getReadMode () const
+{
+  return pimpl_->getReadMode ();
+}
+
 void Serial::flush ()
 {
   ScopedReadLock rlock(this->pimpl_);
   ScopedWriteLock wlock(this->pimpl_);
+  read_buffer_.clear ();
   pimpl_->flush ();
 }
 
 void Serial::flushInput ()
 {
   ScopedReadLock lock(this->pimpl_);
+  read_buffer_.clear ();
   pimpl_->flushInput ();
 }
 
@@ -389,6 +413,11 @@ void Serial::sendBreak (int duration)
   pimpl_->sendBreak (duration);
 }
 
+bool Serial::setLowLatency (bool enabled)
+{
+  return pimpl_->setLowLatency (enabled);
+}
+
 void Serial::setBreak (bool level)
 {
   pimpl_->setBreak (level);
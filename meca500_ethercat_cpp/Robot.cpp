@@ -17,7 +17,7 @@ Robot::Robot(double pos_limit_inf, double pos_limit_sup, uint32_t target_cycle_t
                                        POS_LIMIT_SUP(pos_limit_sup),
                                        master(network_interface_in, FALSE, EC_TIMEOUT_TO_SAFE_OP),
                                        meca500(1, &master),
-                                       controller(&meca500, 0.5),
+                                       controller(&master, &meca500, nullptr, 0.5),
                                        TARGET_CYCLE_TIME_MICROSECONDS(target_cycle_time_microseconds)
 
 {
@@ -137,6 +137,20 @@ void Robot::get_pose(float *x) // Returning pose, cartesian(mm) and angular(°)
     */
 }
 
+void Robot::get_pose_stamped(float *x, int64_t &timestamp_ns, int64_t *dc_time_ns) // pose and CLOCK_MONOTONIC_RAW time (ns) of the EtherCAT frame that carried it
+{
+    int64 timestamp, dc_time;
+    meca500.getPoseStamped(x, &timestamp, &dc_time);
+    timestamp_ns = timestamp;
+    if (dc_time_ns != nullptr)
+        *dc_time_ns = dc_time;
+}
+
+void Robot::on_exchange(std::function<void(int64_t timestamp_ns, int64_t dc_time_ns)> callback) // called by the EtherCAT thread after every exchange
+{
+    master.setExchangeCallback(callback);
+}
+
 double Robot::get_velocity()
 {
     // implementato con derivatore discreto in banda sulla posizione
@@ -57,6 +57,8 @@ public:
 
     double get_position();
     void get_pose(float *x);
+    void get_pose_stamped(float *x, int64_t &timestamp_ns, int64_t *dc_time_ns = nullptr);
+    void on_exchange(std::function<void(int64_t timestamp_ns, int64_t dc_time_ns)> callback);
     void print_pose();
     double get_velocity();
 
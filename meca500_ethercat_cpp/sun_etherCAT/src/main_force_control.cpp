@@ -4,7 +4,7 @@
 #include <stdexcept>
 #include <chrono>
 #include <fstream>
-#include "Controller_force.h"
+#include "Controller.h"
 
 using namespace sun;
 typedef int (Meca500::*meca_fun_ptr)(uint16);
@@ -25,7 +25,7 @@ int main(int argc, char *argv[])
             Master master(ifname, FALSE, EC_TIMEOUT_TO_SAFE_OP);
             ATINano43 forceSensor(1, &master, 1000000);
             Meca500 meca500(1, &master);
-            Controller_force controller_force(&meca500, 0.5);
+            Controller controller_force(&master, &meca500, &forceSensor, 0.5);
 
             master.setupSlave(meca500.getPosition(), Meca500::setup_static);
             //master.config_ec_sync0(1,TRUE,1000000,500000);
@@ -26,7 +26,7 @@ int main(int argc, char *argv[])
             long time_new_packet[500];
             Master master(ifname, FALSE, EC_TIMEOUT_TO_SAFE_OP);
             Meca500 meca500(1, &master);
-            Controller controller(&meca500, 0.5);
+            Controller controller(&master, &meca500, nullptr, 0.5); //the trajectory runs on the DC time
 
             master.setupSlave(meca500.getPosition(), Meca500::setup_static);
 
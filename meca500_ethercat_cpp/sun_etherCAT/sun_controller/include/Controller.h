@@ -3,23 +3,68 @@
 
 #include "Meca500.h"
 #include "ATINano43.h"
+#include "TraceRecorder.h"
+#include "Trajectory.h"
 #include <pthread.h>
+#include <functional>
+#include <memory>
+
+#define CONTROL_MAX_OVERRUNS 10      // consecutive cycles over the time budget before the control loop stops
+#define CONTROL_TIMEOUT_CYCLES 10    // cycles without process data exchanges before the control loop stops
+
+#define POSITION_TRACE_FILE "position_loop_trace.csv"       // samples of position_loop_control
+#define POSITION_TRIGGER_FILE "position_loop_trigger.csv"   // samples around the following error spikes
+#define POSITION_TRACE_CAPACITY 4096 // samples kept in memory, the drain thread writes them every TRACE_DRAIN_PERIOD_US
+#define POSITION_TRIGGER_ERROR 5.0   // following error starting a capture [deg]
+#define POSITION_TRIGGER_PRE 500     // samples captured before the spike
+#define POSITION_TRIGGER_POST 500    // samples captured after the spike
+
+#define FORCE_TARGET_DEFAULT 2.0     // contact force of start_force_control [N]
+#define FORCE_HOLD_DEFAULT 2.0       // time the contact force is held [s]
+#define FORCE_TOLERANCE 0.1          // the force is reached within +-FORCE_TOLERANCE [N]
+#define FORCE_LIMIT 20.0             // the force control stops above this force [N]
+#define FORCE_MAX_VELOCITY 5.0       // maximum velocity along the tool z axis [mm/s]
+#define FORCE_SIGN 1.0               // sign of fz when the tool presses the target, -1 if the sensor is mounted the other way
 
 namespace sun
 {
+    /**
+     * Timing of a cycle-synchronous control loop, see Controller::startCycleLoop.
+     * Latency and execution are measured from the end of the process data exchange.
+    */
+    struct CycleStats
+    {
+        uint64 runs = 0;             /**< executions of the control law */
+        uint64 missed_cycles = 0;    /**< exchanges completed while the law was still running */
+        uint64 overruns = 0;         /**< executions ended after the time budget */
+        int64 max_latency = 0;       /**< longest delay between the exchange and the start of the law [ns] */
+        int64 max_execution = 0;     /**< longest execution of the law [ns] */
+    };
+
     class Controller
     {
     private:
         Meca500 *meca500;
+        Master *master = nullptr;
+        EtherCAT::ATINano43 *force_sensor = nullptr;
         float gain;
         std::thread thread_controller;
-        
-        
+        CycleStats cycle_stats;
+        std::unique_ptr<TraceRecorder> trace; // recording of position_loop_control, closed by waitLoop
+
+        /**
+         * Runs law after every process data exchange until it returns false, the time budget is exceeded
+         * CONTROL_MAX_OVERRUNS times in a row or the exchanges stop, then runs stop.
+        */
+        void cycle_loop(std::function<bool(int64)> law, std::function<void()> stop, int64 budget);
+
     public:
         /**
-         *Costruttore
+         * Costruttore: tutti i loop girano sincronizzati sul ciclo EtherCAT, quindi serve il master.
+         * @param EtherCAT::ATINano43* force_sensor nullptr without force control.
+         * @param float gain proportional gain of the position loop [1/s] or of the force control [mm/s per N]
         */
-        Controller(Meca500 *meca500, float gain);
+        Controller(Master *master, Meca500 *meca500, EtherCAT::ATINano43 *force_sensor, float gain);
 
         /**
          *Distruttore
@@ -27,19 +72,45 @@ namespace sun
         ~Controller();
 
         /**
-         * Create thread
+         * Create thread, see position_loop_control
         */
         void startThread();
 
         /**
-         * 
+         * Starts the position control of joint 6 on a smooth step: a quintic Trajectory sampled on the DC
+         * time of every exchange by startCycleLoop, so it stops with the exchanges too. The samples go to
+         * POSITION_TRACE_FILE and the ones around following errors above POSITION_TRIGGER_ERROR to
+         * POSITION_TRIGGER_FILE (see TraceRecorder), both closed by waitLoop().
+         * @throw runtime_error if the controller has no master or the trace files can't be created.
         */ 
        void position_loop_control();
 
        void waitLoop();
 
-       void start_force_control();
+        /**
+         * Starts a real-time thread running law once per EtherCAT cycle, right after the process data
+         * exchange (see Master::waitCycle). law receives the DC time of the exchange [ns] and returns false
+         * to stop; the missed cycles are counted in CycleStats.
+         * @param stop called when the loop ends for any reason, stops the robot in the mode used by law
+         * (i.e. moveJointsVel or moveLinVelTRF with zero velocities).
+         * @param int64 budget maximum time from the exchange to the end of the law [ns], 0 for half cycle.
+         * @throw runtime_error if the controller has no master.
+        */
+        void startCycleLoop(std::function<bool(int64 dc_time)> law, std::function<void()> stop, int64 budget = 0);
+
+        /**
+         * Presses the target along the z axis of the TRF with a proportional force control running at
+         * the EtherCAT cycle rate (moveLinVelTRF), until the force has been held for hold_time.
+         * The force is zeroed on the first cycle, so the tool must not touch the target when it starts.
+         * @throw runtime_error if the controller has no master or force sensor.
+        */
+        void start_force_control(double target_force = FORCE_TARGET_DEFAULT, double hold_time = FORCE_HOLD_DEFAULT);
+
+        /**
+         * Timing of the last cycle-synchronous loop, valid after waitLoop().
+        */
+        CycleStats getCycleStats();
     };
 } // namespace sun
 
-#endif
\ No newline at end of file
+#endif
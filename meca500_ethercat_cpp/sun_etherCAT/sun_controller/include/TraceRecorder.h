@@ -0,0 +1,167 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define TRACE_DRAIN_PERIOD_US 10000 // period of the thread writing the samples to the file
+
+namespace sun
+{
+    /**
+     * Channel of a TraceRecorder, returned by addChannel and used by set
+    */
+    template <typename T>
+    struct TraceChannel
+    {
+        size_t index;
+    };
+
+    /**
+     * Recorder of the variables of a real-time loop. The channels are registered before start(), which
+     * allocates a ring buffer of capacity samples; afterwards set() and commit() only copy values and never
+     * block or allocate. A thread drains the ring and writes the samples to a csv file.
+     *
+     * When the drain can't keep up the ring is full: with OVERWRITE the oldest samples are lost, with STOP
+     * the newest ones are dropped. Either way they are counted by lostSamples().
+     *
+     * With armTrigger(pre, post), trigger() (i.e. on a following error spike) also writes the pre samples
+     * before the event and the post samples after it to a second file, one capture at a time.
+    */
+    class TraceRecorder
+    {
+    public:
+        enum Policy
+        {
+            OVERWRITE,
+            STOP
+        };
+
+    private:
+        enum ChannelType
+        {
+            FLOATING,
+            SIGNED,
+            UNSIGNED
+        };
+
+        size_t capacity;
+        Policy policy;
+        std::vector<std::string> names;
+        std::vector<ChannelType> types;
+
+        // values are stored as 64 bit patterns in relaxed atomics: the drain validates a copied sample
+        // with the counter of the samples started by the producer (seqlock). The first slot of every
+        // sample holds its number, so the samples dropped with STOP leave a gap in the file.
+        std::unique_ptr<std::atomic<uint64_t>[]> ring;
+        std::vector<uint64_t> pending;
+        std::atomic<uint64_t> started{0};   // samples whose copy into the ring has started
+        std::atomic<uint64_t> committed{0}; // samples completely in the ring
+        std::atomic<uint64_t> drained{0};   // samples read by the drain
+        std::atomic<uint64_t> dropped{0};   // samples refused by commit with STOP
+        std::atomic<uint64_t> overwritten{0};
+
+        size_t trigger_pre = 0, trigger_post = 0;
+        bool capturing = false;
+        std::atomic<int64_t> trigger_sample{-1}; // position in the ring of the pending capture, -1 if none
+        std::atomic<uint64_t> trigger_number{0};  // number of the sample of the pending capture
+        std::atomic<uint64_t> captures{0};
+
+        std::ofstream file;
+        std::ofstream trigger_file;
+        std::thread drain_thread;
+        std::atomic<bool> running{false};
+
+        template <typename T>
+        static uint64_t encode(T value)
+        {
+            uint64_t bits = 0;
+            if (std::is_floating_point<T>::value)
+            {
+                double converted = (double)value;
+                memcpy(&bits, &converted, sizeof(bits));
+            }
+            else if (std::is_signed<T>::value)
+                bits = (uint64_t)(int64_t)value;
+            else
+                bits = (uint64_t)value;
+            return bits;
+        }
+
+        // copies a sample out of the ring, false if the producer overwrote it meanwhile
+        bool read(uint64_t sample, std::vector<uint64_t> &values);
+        void write(std::ofstream &out, const std::vector<uint64_t> &values, const int64_t *offset);
+        void drain();
+        void capture(uint64_t available);
+
+    public:
+        TraceRecorder(size_t capacity, Policy policy = OVERWRITE);
+        ~TraceRecorder();
+
+        /**
+         * Registers a channel, floating point or integer.
+         * @throw logic_error after start().
+        */
+        template <typename T>
+        TraceChannel<T> addChannel(const std::string &name)
+        {
+            static_assert(std::is_arithmetic<T>::value, "trace channels must be numbers");
+            if (ring)
+                throw std::logic_error("Trace channels must be added before start\n");
+            names.push_back(name);
+            types.push_back(std::is_floating_point<T>::value ? FLOATING : (std::is_signed<T>::value ? SIGNED : UNSIGNED));
+            return TraceChannel<T>{names.size() - 1};
+        }
+
+        /**
+         * Captures pre samples before and post samples after every trigger() to trigger_filename of start().
+         * @throw invalid_argument if the capture doesn't fit in the ring, logic_error after start().
+        */
+        void armTrigger(size_t pre, size_t post);
+
+        /**
+         * Allocates the ring, opens the files and starts the drain thread.
+         * @throw runtime_error if a file can't be created.
+        */
+        void start(const std::string &filename, const std::string &trigger_filename = "");
+
+        /**
+         * Sets the value of a channel in the sample being prepared (real-time safe)
+        */
+        template <typename T>
+        void set(TraceChannel<T> channel, T value)
+        {
+            pending[channel.index + 1] = encode(value);
+        }
+
+        /**
+         * Appends the prepared sample to the ring (real-time safe).
+         * @return false if the sample was dropped (STOP policy with the ring full).
+        */
+        bool commit();
+
+        /**
+         * Marks the sample being prepared as a trigger event, ignored while a capture is pending (real-time safe)
+        */
+        void trigger();
+
+        /**
+         * Writes the samples left in the ring, stops the drain thread and closes the files
+        */
+        void stop();
+
+        uint64_t samples();
+        uint64_t lostSamples();
+        uint64_t getCaptures();
+    };
+} // namespace sun
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define TRAJECTORY_MAX_SEGMENTS 3 // pieces of the normalized profile (acceleration, cruise, deceleration)
+
+namespace sun
+{
+    /**
+     * Rest-to-rest motion of any number of axes along a straight line, in joint space (deg) or in
+     * cartesian space (x, y, z in mm and the alpha, beta, gamma angles in deg, interpolated one by one).
+     *
+     * Every axis follows start + (end - start) * s(t), where s goes from 0 to 1 with a quintic polynomial
+     * (zero velocity and acceleration at the ends) or a trapezoidal velocity synchronized on the slowest
+     * axis. The pieces of s are polynomials whose coefficients are computed by the constructor, so
+     * sample() costs a Horner evaluation plus one multiply-add per axis and never allocates.
+    */
+    class Trajectory
+    {
+    private:
+        struct Segment
+        {
+            double begin;       /**< start of the piece [s] */
+            double position[6]; /**< coefficients of s in the time from begin, lowest degree first */
+            double velocity[5]; /**< coefficients of ds/dt */
+        };
+
+        std::vector<double> start;
+        std::vector<double> delta;
+        Segment segments[TRAJECTORY_MAX_SEGMENTS];
+        int segments_count = 0;
+        double duration = 0;
+        int64_t start_time = 0;
+
+        void check_axes(const std::vector<double> &start, const std::vector<double> &end);
+        void add_segment(double begin, double c0, double c1, double c2, double c3 = 0, double c4 = 0, double c5 = 0);
+
+    public:
+        /**
+         * Quintic profile lasting duration.
+         * @param double duration [s]
+         * @throw invalid_argument if start and end have different sizes or the duration isn't positive.
+        */
+        Trajectory(const std::vector<double> &start, const std::vector<double> &end, double duration);
+
+        /**
+         * Trapezoidal velocity profile, as fast as the limits of every axis allow: all the axes start and
+         * stop together, so the slowest one sets the duration.
+         * @param max_velocity per axis [unit/s]
+         * @param max_acceleration per axis [unit/s^2]
+         * @throw invalid_argument if the sizes differ or a limit isn't positive.
+        */
+        Trajectory(const std::vector<double> &start, const std::vector<double> &end,
+                   const std::vector<double> &max_velocity, const std::vector<double> &max_acceleration);
+
+        /**
+         * Sets the time at which the motion starts, on the clock passed to sample() (i.e. the DC time) [ns]
+        */
+        void setStartTime(int64_t start_time);
+
+        /**
+         * Position and, if velocity isn't null, velocity of every axis at time (same clock of setStartTime).
+         * Before the start the axes are at start, after the end they stay at end.
+         * @param int64 time [ns]
+         * @return bool false once the motion is over.
+        */
+        bool sample(int64_t time, double *position, double *velocity = nullptr) const;
+
+        /**
+         * Same as sample() with the time from the start of the motion [s]
+        */
+        void evaluate(double t, double *position, double *velocity = nullptr) const;
+
+        double getDuration() const;
+        int64_t getStartTime() const;
+        size_t getAxes() const;
+    };
+} // namespace sun
+
+#endif
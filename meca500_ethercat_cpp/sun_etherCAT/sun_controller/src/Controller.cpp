@@ -1,13 +1,25 @@
 #include "Controller.h"
 #include <fstream>
 #include <cmath>
+#include <stdexcept>
+#include <time.h>
+
+//stesso riferimento temporale di Master::getExchangeTime
+static int64 monotonic_raw_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (int64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
 
 namespace sun
 {
-    Controller::Controller(Meca500 *meca500, float gain)
+    Controller::Controller(Master *master, Meca500 *meca500, EtherCAT::ATINano43 *force_sensor, float gain)
     {
         this->gain = gain;
         this->meca500 = meca500;
+        this->master = master;
+        this->force_sensor = force_sensor;
     }
 
     Controller::~Controller()
@@ -16,131 +28,211 @@ namespace sun
 
     void Controller::startThread()
     {
-        thread_controller = std::thread(&Controller::position_loop_control, this);
+        position_loop_control();
     }
 
     void Controller::position_loop_control()
     {
-        struct sched_attr attr;
-        attr.size = sizeof(attr);
-        sched_rr(&attr, 30, 0);
-
-        std::cout << "Start real time controller thread\n";
+        //senza master il loop non parte: la registrazione non va avviata
+        if (master == nullptr)
+            throw std::runtime_error("The position loop needs the master\n");
 
-        float error;
-        float joint_position_measured;
-        float omega[6] = {0, 0, 0, 0, 0, 0};
-        float joint[6] = {0, 0, 0, 0, 0, 0};
-        float joint_velocities[6] = {0, 0, 0, 0, 0, 0};
-
-        int count = 0;
-        int i = 0; //iterazioni
-        int sample = 0;
-
-        //test variables
-        float data_position_joint[50000];
-        float data_error[50000];
-        float data_vel[50000];
-        float data_measured_vel[50000];
-        int64 time_x[50000];
+        //registrazione: il ring è allocato prima del loop, il thread di scrittura lo svuota nel file
+        trace.reset(new TraceRecorder(POSITION_TRACE_CAPACITY));
+        struct
+        {
+            TraceChannel<double> time, reference, reference_velocity, position, error, velocity, measured_velocity;
+            TraceChannel<int64> timestamp;
+        } channels;
+        channels.time = trace->addChannel<double>("time");
+        channels.timestamp = trace->addChannel<int64>("timestamp");
+        channels.reference = trace->addChannel<double>("reference");
+        channels.reference_velocity = trace->addChannel<double>("reference_velocity");
+        channels.position = trace->addChannel<double>("position");
+        channels.error = trace->addChannel<double>("error");
+        channels.velocity = trace->addChannel<double>("velocity");
+        channels.measured_velocity = trace->addChannel<double>("measured_velocity");
+        trace->armTrigger(POSITION_TRIGGER_PRE, POSITION_TRIGGER_POST);
+        trace->start(POSITION_TRACE_FILE, POSITION_TRIGGER_FILE);
 
         //control variables
-        float theta_0, theta_f = 90;
-        float t0;
-        float tf = 10;      //Time in ns
-        float istant_time=0;
-
-        float theta_d;
-        float b[6] = {6, -15, 10, 0, 0, 0};
-        float tau = 0;
+        double theta_f = 90;
+        double tf = 10;      //Time in s
 
+        float joint[6] = {0, 0, 0, 0, 0, 0};
         meca500->getJoints(joint);
-        theta_0 = joint[5];
 
-        //t0 = ec_DCtime;
-        t0 = 0;
-        while (count < 1)
-        {
-            //tau = ((float)(ec_DCtime - t0)) / tf;
-            //printf("%f\n",tau);
-            if(istant_time<tf)
+        //gradino smooth (quintica) sul giunto 6: parte dal primo scambio e avanza con il tempo DC di ogni ciclo
+        Trajectory trajectory({joint[5]}, {theta_f}, tf);
+        bool started = false;
+        TraceRecorder *recorder = trace.get();
+        startCycleLoop([this, trajectory, started, channels, recorder](int64 dc_time) mutable
+                       {
+            if (!started)
             {
-                tau = istant_time/ tf;
-                istant_time = istant_time + 0.001;
-                theta_d = theta_0 + (theta_f - theta_0) * (b[0] * pow(tau, 5) + b[1] * pow(tau, 4) + b[2] * pow(tau, 3));
+                trajectory.setStartTime(dc_time);
+                started = true;
             }
-            else count++;
-            
-            //printf("%f\n",theta_d);
+            double theta_d, omega_d;
+            bool moving = trajectory.sample(dc_time, &theta_d, &omega_d);
+
             //measured position
+            float joint[6], joint_velocities[6];
+            float omega[6] = {0, 0, 0, 0, 0, 0};
             meca500->getJoints(joint);
-            joint_position_measured = joint[5];
-
-            error = theta_d - joint_position_measured;
+            double error = theta_d - joint[5];
 
             omega[5] = error * gain;
             meca500->moveJointsVel(omega);
 
             meca500->getJointsVelocities(joint_velocities);
 
-            if (i < 50000)
-            {
-                time_x[i] = istant_time;
-                data_position_joint[i] = joint_position_measured;
-                data_error[i] = error;
-                data_vel[i] = omega[5];
-                data_measured_vel[i] = joint_velocities[5];
-            }
-            // if (joint_position_measured > theta_f-0.001  && joint_position_measured < theta_f+0.001)
-            //     count++;
-            // else
-            //     count = 0;
-            i++;
-            osal_usleep(1000);
+            recorder->set(channels.time, (dc_time - trajectory.getStartTime()) * 1e-9);
+            recorder->set(channels.timestamp, monotonic_raw_ns());
+            recorder->set(channels.reference, theta_d);
+            recorder->set(channels.reference_velocity, omega_d);
+            recorder->set(channels.position, (double)joint[5]);
+            recorder->set(channels.error, error);
+            recorder->set(channels.velocity, (double)omega[5]);
+            recorder->set(channels.measured_velocity, (double)joint_velocities[5]);
+            if (std::fabs(error) > POSITION_TRIGGER_ERROR)
+                recorder->trigger();
+            recorder->commit();
+
+            //il passo con il riferimento finale è l'ultimo
+            return moving; },
+                       [this]()
+                       {
+                           float omega[6] = {0, 0, 0, 0, 0, 0};
+                           meca500->moveJointsVel(omega);
+                       });
+    }
+
+    void Controller::waitLoop()
+    {
+        thread_controller.join();
+
+        if (trace)
+        {
+            trace->stop();
+            std::cout << "Trace: " << trace->samples() << " samples in " << POSITION_TRACE_FILE << ", " << trace->getCaptures() << " following error captures in " << POSITION_TRIGGER_FILE << "\n";
+            trace.reset();
         }
+    }
 
-        std::ofstream oFile_p("Data_position_Joint6.txt", std::ios_base::out | std::ios_base::trunc);
-        if (oFile_p.is_open())
+    void Controller::startCycleLoop(std::function<bool(int64)> law, std::function<void()> stop, int64 budget)
+    {
+        if (master == nullptr)
+            throw std::runtime_error("The cycle loop needs the master\n");
+        if (budget <= 0)
+            budget = master->getCycle() / 2;
+        cycle_stats = CycleStats();
+        thread_controller = std::thread(&Controller::cycle_loop, this, law, stop, budget);
+    }
+
+    void Controller::cycle_loop(std::function<bool(int64)> law, std::function<void()> stop, int64 budget)
+    {
+        //priorità minore del thread del master (40): la legge parte quando lo scambio è concluso
+        struct sched_attr attr;
+        attr.size = sizeof(attr);
+        sched_rr(&attr, 30, 0);
+
+        std::cout << "Start cycle-synchronous controller thread\n";
+
+        int64 timeout = CONTROL_TIMEOUT_CYCLES * master->getCycle();
+        uint64 last_cycle = master->waitCycle(0, timeout);
+        int consecutive_overruns = 0;
+        while (true)
         {
-            if (i > 50000)
-                i = 50000;
-            for (int y = 0; y < i; y++)
+            uint64 cycle = master->waitCycle(last_cycle, timeout);
+            if (cycle == last_cycle)
             {
-                oFile_p << data_position_joint[y] << "\t";
-                oFile_p << time_x[y] - time_x[0] << "\n";
+                std::cout << "Cycle loop stopped: no process data exchanges\n";
+                break;
             }
-            oFile_p.close();
-        }
 
-        std::ofstream oFile_e("Data_error.txt", std::ios_base::out | std::ios_base::trunc);
-        if (oFile_e.is_open())
-        {
-            if (i > 50000)
-                i = 50000;
-            for (int y = 0; y < i; y++)
+            master->mutex_down();
+            int64 exchange_time = master->getExchangeTime();
+            int64 dc_time = master->getExchangeDCTime();
+            master->mutex_up();
+
+            int64 start = monotonic_raw_ns();
+            bool running = law(dc_time);
+            int64 end = monotonic_raw_ns();
+
+            cycle_stats.runs++;
+            cycle_stats.missed_cycles += cycle - last_cycle - 1;
+            cycle_stats.max_latency = std::max(cycle_stats.max_latency, start - exchange_time);
+            cycle_stats.max_execution = std::max(cycle_stats.max_execution, end - start);
+            if (end - exchange_time > budget)
             {
-                oFile_e << data_error[y] << "\t";
-                oFile_e << time_x[y] - time_x[0] << "\n";
+                cycle_stats.overruns++;
+                consecutive_overruns++;
             }
-            oFile_e.close();
-        }
+            else
+                consecutive_overruns = 0;
+            last_cycle = cycle;
 
-        std::ofstream oFile_v("Data_velocities.txt", std::ios_base::out | std::ios_base::trunc);
-        if (oFile_v.is_open())
-        {
-            if (i > 50000)
-                i = 50000;
-            for (int y = 0; y < i; y++)
+            if (!running)
+                break;
+            if (consecutive_overruns >= CONTROL_MAX_OVERRUNS)
             {
-                oFile_v << data_vel[y] << "\t";
-                oFile_v << data_measured_vel[y] << "\n";
+                std::cout << "Cycle loop stopped: " << consecutive_overruns << " cycles over the time budget\n";
+                break;
             }
-            oFile_v.close();
         }
+
+        stop();
+        printf("Cycle loop: %llu runs, %llu missed cycles, %llu overruns, max latency %lld ns, max execution %lld ns\n",
+               (unsigned long long)cycle_stats.runs, (unsigned long long)cycle_stats.missed_cycles,
+               (unsigned long long)cycle_stats.overruns, (long long)cycle_stats.max_latency, (long long)cycle_stats.max_execution);
     }
 
-    void Controller::waitLoop()
+    void Controller::start_force_control(double target_force, double hold_time)
     {
-        thread_controller.join();
+        if (force_sensor == nullptr)
+            throw std::runtime_error("The force control needs the force sensor\n");
+
+        double tare = 0;
+        bool tared = false;
+        int64 hold_start = -1;
+        startCycleLoop([this, target_force, hold_time, tare, tared, hold_start](int64 dc_time) mutable
+                       {
+            double forces[3];
+            force_sensor->getForces(forces);
+            if (!tared)
+            {
+                tare = forces[2];
+                tared = true;
+            }
+            double force = FORCE_SIGN * (forces[2] - tare);
+            if (force > FORCE_LIMIT)
+            {
+                printf("Force control stopped: %f N over the limit\n", force);
+                return false;
+            }
+
+            //controllo proporzionale: la velocità lungo z del TRF è proporzionale all'errore di forza
+            double error = target_force - force;
+            float velocity[6] = {0, 0, 0, 0, 0, 0};
+            velocity[2] = std::max(-FORCE_MAX_VELOCITY, std::min(FORCE_MAX_VELOCITY, gain * error));
+            meca500->moveLinVelTRF(velocity);
+
+            //il tempo di mantenimento è misurato con il DC time dello scambio
+            if (std::fabs(error) > FORCE_TOLERANCE)
+                hold_start = -1;
+            else if (hold_start < 0)
+                hold_start = dc_time;
+            return hold_start < 0 || dc_time - hold_start < (int64)(hold_time * 1e9); },
+                       [this]()
+                       {
+                           float velocity[6] = {0, 0, 0, 0, 0, 0};
+                           meca500->moveLinVelTRF(velocity);
+                       });
+    }
+
+    CycleStats Controller::getCycleStats()
+    {
+        return cycle_stats;
     }
 } // namespace sun
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "TraceRecorder.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+namespace sun
+{
+    TraceRecorder::TraceRecorder(size_t capacity, Policy policy)
+    {
+        if (capacity == 0)
+            throw std::invalid_argument("The trace needs at least one sample\n");
+        this->capacity = capacity;
+        this->policy = policy;
+    }
+
+    TraceRecorder::~TraceRecorder()
+    {
+        stop();
+    }
+
+    void TraceRecorder::armTrigger(size_t pre, size_t post)
+    {
+        if (ring)
+            throw std::logic_error("The trigger must be armed before start\n");
+        //la finestra deve restare nel ring mentre il drain la scrive
+        if (pre + post + 1 > capacity)
+            throw std::invalid_argument("The trigger window (" + std::to_string(pre + post + 1) + " samples) exceeds the trace capacity (" + std::to_string(capacity) + ")\n");
+        trigger_pre = pre;
+        trigger_post = post;
+    }
+
+    void TraceRecorder::start(const std::string &filename, const std::string &trigger_filename)
+    {
+        if (ring)
+            throw std::logic_error("The trace is already started\n");
+        if (names.empty())
+            throw std::logic_error("The trace has no channels\n");
+
+        file.open(filename, std::ios_base::out | std::ios_base::trunc);
+        if (!file.is_open())
+            throw std::runtime_error("Can't create the trace file " + filename + "\n");
+        file << "sample";
+        for (const std::string &name : names)
+            file << "," << name;
+        file << "\n";
+
+        if (trigger_post + trigger_pre > 0 && !trigger_filename.empty())
+        {
+            trigger_file.open(trigger_filename, std::ios_base::out | std::ios_base::trunc);
+            if (!trigger_file.is_open())
+                throw std::runtime_error("Can't create the trigger file " + trigger_filename + "\n");
+            trigger_file << "capture,sample,trigger";
+            for (const std::string &name : names)
+                trigger_file << "," << name;
+            trigger_file << "\n";
+            capturing = true;
+        }
+
+        ring.reset(new std::atomic<uint64_t>[capacity * (names.size() + 1)]);
+        for (size_t i = 0; i < capacity * (names.size() + 1); i++)
+            ring[i].store(0, std::memory_order_relaxed);
+        pending.assign(names.size() + 1, 0);
+
+        running = true;
+        drain_thread = std::thread(&TraceRecorder::drain, this);
+    }
+
+    bool TraceRecorder::commit()
+    {
+        uint64_t sample = committed.load(std::memory_order_relaxed);
+        pending[0] = sample + dropped.load(std::memory_order_relaxed);
+        if (policy == STOP && sample - drained.load(std::memory_order_acquire) >= capacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        //il drain scarta le copie degli slot riscritti da questo campione
+        started.store(sample + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::atomic<uint64_t> *slot = &ring[(sample % capacity) * pending.size()];
+        for (size_t c = 0; c < pending.size(); c++)
+            slot[c].store(pending[c], std::memory_order_relaxed);
+
+        committed.store(sample + 1, std::memory_order_release);
+        return true;
+    }
+
+    void TraceRecorder::trigger()
+    {
+        if (!capturing)
+            return;
+        //solo il drain rimette -1, a cattura scritta
+        if (trigger_sample.load(std::memory_order_acquire) >= 0)
+            return;
+        trigger_number.store(samples(), std::memory_order_relaxed);
+        trigger_sample.store((int64_t)committed.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+
+    bool TraceRecorder::read(uint64_t sample, std::vector<uint64_t> &values)
+    {
+        const std::atomic<uint64_t> *slot = &ring[(sample % capacity) * values.size()];
+        for (size_t c = 0; c < values.size(); c++)
+            values[c] = slot[c].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return started.load(std::memory_order_relaxed) <= sample + capacity;
+    }
+
+    void TraceRecorder::write(std::ofstream &out, const std::vector<uint64_t> &values, const int64_t *offset)
+    {
+        out << values[0];
+        if (offset != nullptr)
+            out << "," << *offset;
+        for (size_t c = 0; c < types.size(); c++)
+        {
+            out << ",";
+            if (types[c] == FLOATING)
+            {
+                double value;
+                memcpy(&value, &values[c + 1], sizeof(value));
+                out << value;
+            }
+            else if (types[c] == SIGNED)
+                out << (int64_t)values[c + 1];
+            else
+                out << values[c + 1];
+        }
+        out << "\n";
+    }
+
+    void TraceRecorder::capture(uint64_t available)
+    {
+        int64_t event = trigger_sample.load(std::memory_order_acquire);
+        if (event < 0)
+            return;
+        uint64_t center = (uint64_t)event;
+        uint64_t end = std::min(center + trigger_post + 1, available);
+        if (end < center + trigger_post + 1 && running)
+            return; //aspetta i campioni successivi all'evento
+
+        uint64_t begin = center > trigger_pre ? center - trigger_pre : 0;
+        uint64_t number = trigger_number.load(std::memory_order_relaxed);
+        std::vector<uint64_t> values(names.size() + 1);
+        bool written = false;
+        for (uint64_t sample = begin; sample < end; sample++)
+        {
+            if (!read(sample, values))
+                continue;
+            int64_t offset = (int64_t)values[0] - (int64_t)number;
+            trigger_file << captures.load(std::memory_order_relaxed) << ",";
+            write(trigger_file, values, &offset);
+            written = true;
+        }
+        trigger_file.flush();
+        //una finestra già sovrascritta non conta come cattura
+        if (written)
+            captures++;
+        trigger_sample.store(-1, std::memory_order_release);
+    }
+
+    void TraceRecorder::drain()
+    {
+        std::vector<uint64_t> values(names.size() + 1);
+        bool last = false;
+        while (!last)
+        {
+            //l'ultimo giro scrive quanto resta dopo lo stop
+            last = !running.load(std::memory_order_acquire);
+
+            uint64_t available = committed.load(std::memory_order_acquire);
+            uint64_t sample = drained.load(std::memory_order_relaxed);
+            if (available - sample > capacity)
+            {
+                overwritten.fetch_add(available - capacity - sample, std::memory_order_relaxed);
+                sample = available - capacity;
+            }
+            for (; sample < available; sample++)
+            {
+                if (read(sample, values))
+                    write(file, values, nullptr);
+                else
+                    overwritten.fetch_add(1, std::memory_order_relaxed);
+            }
+            drained.store(available, std::memory_order_release);
+            file.flush();
+
+            if (capturing)
+                capture(available);
+
+            if (!last)
+                std::this_thread::sleep_for(std::chrono::microseconds(TRACE_DRAIN_PERIOD_US));
+        }
+    }
+
+    void TraceRecorder::stop()
+    {
+        if (!drain_thread.joinable())
+            return;
+        running = false;
+        drain_thread.join();
+        file.close();
+        if (capturing)
+            trigger_file.close();
+        capturing = false;
+
+        uint64_t lost = lostSamples();
+        if (lost > 0)
+            std::cerr << "Trace: " << lost << " of " << samples() << " samples lost, the ring of " << capacity << " samples is too small for the drain period\n";
+    }
+
+    uint64_t TraceRecorder::samples()
+    {
+        return committed.load(std::memory_order_relaxed) + dropped.load(std::memory_order_relaxed);
+    }
+
+    uint64_t TraceRecorder::lostSamples()
+    {
+        return dropped.load(std::memory_order_relaxed) + overwritten.load(std::memory_order_relaxed);
+    }
+
+    uint64_t TraceRecorder::getCaptures()
+    {
+        return captures.load(std::memory_order_relaxed);
+    }
+} // namespace sun
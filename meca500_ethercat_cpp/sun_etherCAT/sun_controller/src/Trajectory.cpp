@@ -0,0 +1,144 @@
+#include "Trajectory.h"
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace sun
+{
+    Trajectory::Trajectory(const std::vector<double> &start, const std::vector<double> &end, double duration)
+    {
+        check_axes(start, end);
+        if (!(duration > 0))
+            throw std::invalid_argument("The duration of the trajectory must be positive\n");
+        this->duration = duration;
+
+        //s(t) = 10 (t/T)^3 - 15 (t/T)^4 + 6 (t/T)^5
+        double T3 = duration * duration * duration;
+        add_segment(0, 0, 0, 0, 10 / T3, -15 / (T3 * duration), 6 / (T3 * duration * duration));
+    }
+
+    Trajectory::Trajectory(const std::vector<double> &start, const std::vector<double> &end,
+                           const std::vector<double> &max_velocity, const std::vector<double> &max_acceleration)
+    {
+        check_axes(start, end);
+        if (max_velocity.size() != delta.size() || max_acceleration.size() != delta.size())
+            throw std::invalid_argument("The trajectory needs the velocity and acceleration limits of every axis\n");
+
+        //limiti sul profilo normalizzato s: l'asse più lento li fissa per tutti
+        double V = INFINITY, A = INFINITY;
+        for (size_t i = 0; i < delta.size(); i++)
+        {
+            if (!(max_velocity[i] > 0) || !(max_acceleration[i] > 0))
+                throw std::invalid_argument("The limits of axis " + std::to_string(i + 1) + " must be positive\n");
+            if (delta[i] != 0)
+            {
+                V = std::fmin(V, max_velocity[i] / std::fabs(delta[i]));
+                A = std::fmin(A, max_acceleration[i] / std::fabs(delta[i]));
+            }
+        }
+
+        if (std::isinf(V))
+        {
+            //nessun movimento
+            add_segment(0, 1, 0, 0);
+            return;
+        }
+
+        double ta;
+        if (V * V / A >= 1)
+        {
+            //profilo triangolare: la velocità massima non viene raggiunta
+            ta = std::sqrt(1 / A);
+            V = A * ta;
+            duration = 2 * ta;
+        }
+        else
+        {
+            ta = V / A;
+            duration = ta + 1 / V;
+        }
+
+        add_segment(0, 0, 0, A / 2);
+        add_segment(ta, A * ta * ta / 2, V, 0);
+        add_segment(duration - ta, 1 - A * ta * ta / 2, A * ta, -A / 2);
+    }
+
+    void Trajectory::check_axes(const std::vector<double> &start, const std::vector<double> &end)
+    {
+        if (start.empty() || start.size() != end.size())
+            throw std::invalid_argument("Start and end of the trajectory must have the same axes\n");
+        this->start = start;
+        delta.resize(start.size());
+        for (size_t i = 0; i < start.size(); i++)
+            delta[i] = end[i] - start[i];
+    }
+
+    void Trajectory::add_segment(double begin, double c0, double c1, double c2, double c3, double c4, double c5)
+    {
+        Segment &segment = segments[segments_count++];
+        segment.begin = begin;
+        double c[6] = {c0, c1, c2, c3, c4, c5};
+        for (int k = 0; k < 6; k++)
+            segment.position[k] = c[k];
+        for (int k = 0; k < 5; k++)
+            segment.velocity[k] = (k + 1) * c[k + 1];
+    }
+
+    void Trajectory::setStartTime(int64_t start_time)
+    {
+        this->start_time = start_time;
+    }
+
+    bool Trajectory::sample(int64_t time, double *position, double *velocity) const
+    {
+        double t = (double)(time - start_time) * 1e-9;
+        evaluate(t, position, velocity);
+        return t < duration;
+    }
+
+    void Trajectory::evaluate(double t, double *position, double *velocity) const
+    {
+        double s, ds = 0;
+        if (t <= 0)
+            s = 0;
+        else if (t >= duration)
+            s = 1;
+        else
+        {
+            int i = segments_count - 1;
+            while (i > 0 && t < segments[i].begin)
+                i--;
+            const Segment &segment = segments[i];
+            double x = t - segment.begin;
+
+            s = segment.position[5];
+            for (int k = 4; k >= 0; k--)
+                s = s * x + segment.position[k];
+            ds = segment.velocity[4];
+            for (int k = 3; k >= 0; k--)
+                ds = ds * x + segment.velocity[k];
+        }
+
+        for (size_t i = 0; i < delta.size(); i++)
+        {
+            position[i] = start[i] + delta[i] * s;
+            if (velocity != nullptr)
+                velocity[i] = delta[i] * ds;
+        }
+    }
+
+    double Trajectory::getDuration() const
+    {
+        return duration;
+    }
+
+    int64_t Trajectory::getStartTime() const
+    {
+        return start_time;
+    }
+
+    size_t Trajectory::getAxes() const
+    {
+        return delta.size();
+    }
+} // namespace sun
@@ -11,9 +11,11 @@
 #include <sched.h>
 #include <time.h>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include "ethercat.h"
 #include <array>
+#include <functional>
 
 extern "C"
 {
@@ -39,6 +41,12 @@ namespace sun
         long int time2;
         std::array<int,50000> timecycle;
         long int cycle;
+        int64 exchange_time;    /**< CLOCK_MONOTONIC_RAW time [ns] of the last completed process data exchange */
+        int64 exchange_dc_time; /**< DC time [ns] of the last completed process data exchange */
+        std::function<void(int64, int64)> exchange_callback;
+        uint64 exchange_count = 0;          /**< completed process data exchanges, guarded by cycle_mtx */
+        std::mutex cycle_mtx;
+        std::condition_variable cycle_cv; /**< notified after every exchange, once the IObuffer is released */
         volatile int wkc;
         int64 cycletime;
         void ecatthread();
@@ -170,6 +178,44 @@ namespace sun
 
         uint8 *getInput_slave(uint16 position);
 
+        /**
+         * Returns the CLOCK_MONOTONIC_RAW time (in ns) at which the last process data exchange completed.
+         * This is the common timeline of the timebase module, so it can be compared with the timestamps
+         * taken by other threads. It must be called holding the IObuffer mutex to be consistent with the inputs.
+         * @return int64 time of the last exchange in ns, 0 if no exchange happened yet.
+        */
+        int64 getExchangeTime();
+
+        /**
+         * Returns the DC time (ec_DCtime, in ns) of the last process data exchange.
+         * It must be called holding the IObuffer mutex to be consistent with the inputs.
+        */
+        int64 getExchangeDCTime();
+
+        /**
+         * Sets a function called by the real-time thread after every process data exchange with the
+         * CLOCK_MONOTONIC_RAW time and the DC time of the exchange, i.e. to estimate the DC clock drift.
+         * The callback runs holding the IObuffer mutex: it must be short and it must not call mutex_down().
+         * @param callback function receiving (timestamp, dc_time), both in ns.
+        */
+        void setExchangeCallback(std::function<void(int64 timestamp, int64 dc_time)> callback);
+
+        /**
+         * Blocks until a process data exchange newer than last_cycle has completed, so that a control loop
+         * runs once per cycle right after the new inputs arrived. The IObuffer is already released when it
+         * returns, the slaves can be read and written as usual.
+         * @param uint64 last_cycle value returned by the previous call, 0 the first time.
+         * @param int64 timeout maximum wait in ns.
+         * @return uint64 number of the last completed exchange, last_cycle if the timeout expired.
+         *         More than last_cycle + 1 means that the caller missed some cycles.
+        */
+        uint64 waitCycle(uint64 last_cycle, int64 timeout);
+
+        /**
+         * Returns the cycle time of the real-time thread in ns.
+        */
+        int64 getCycle();
+
         /**
          * Each slave has to call this method to access the IObuffer.
         */
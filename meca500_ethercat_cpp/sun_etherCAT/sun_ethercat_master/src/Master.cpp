@@ -183,7 +183,7 @@ namespace sun
 
     void Master::ecatthread()
     {
-        struct timespec ts, tleft;
+        struct timespec ts, tleft, tstamp;
         int ht;
         struct sched_attr attr;
         attr.size = sizeof(attr);
@@ -194,6 +194,8 @@ namespace sun
         ht = (ts.tv_nsec / 1000000) + 1; // round to nearest ms
         ts.tv_nsec = ht * 1000000;
         toff = 0;
+        exchange_time = 0;
+        exchange_dc_time = 0;
         // eseguo il pinning della pagine attuali e future occupate dal thread per garantire
         //   prevedibilità nelle prestazioni real-time
         if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1)
@@ -213,8 +215,20 @@ namespace sun
             mtx.lock();
             ec_send_processdata();
             wkc = ec_receive_processdata(EC_TIMEOUTRET);
+            clock_gettime(CLOCK_MONOTONIC_RAW, &tstamp);
+            exchange_time = (int64)tstamp.tv_sec * NSEC_PER_SEC + tstamp.tv_nsec;
+            exchange_dc_time = ec_DCtime;
+            if (exchange_callback)
+                exchange_callback(exchange_time, exchange_dc_time);
             mtx.unlock();
 
+            //sveglia i loop di controllo sincronizzati sul ciclo, a IObuffer libero
+            {
+                std::lock_guard<std::mutex> lock(cycle_mtx);
+                exchange_count++;
+            }
+            cycle_cv.notify_all();
+
             this->ec_sync(ec_DCtime, cycletime, &toff);
             time2 = ec_DCtime;
             cycle = time2 - time1;
@@ -308,6 +322,36 @@ namespace sun
         return ec_slave[position].inputs;
     }
 
+    int64 Master::getExchangeTime()
+    {
+        return exchange_time;
+    }
+
+    int64 Master::getExchangeDCTime()
+    {
+        return exchange_dc_time;
+    }
+
+    void Master::setExchangeCallback(std::function<void(int64 timestamp, int64 dc_time)> callback)
+    {
+        mtx.lock();
+        exchange_callback = callback;
+        mtx.unlock();
+    }
+
+    uint64 Master::waitCycle(uint64 last_cycle, int64 timeout)
+    {
+        std::unique_lock<std::mutex> lock(cycle_mtx);
+        cycle_cv.wait_for(lock, std::chrono::nanoseconds(timeout), [&]()
+                          { return exchange_count > last_cycle; });
+        return exchange_count > last_cycle ? exchange_count : last_cycle;
+    }
+
+    int64 Master::getCycle()
+    {
+        return cycletime;
+    }
+
     void Master::mutex_down()
     {
         mtx.lock();
@@ -281,6 +281,15 @@ namespace sun
         */
         void getPose(float *pose);
 
+        /**
+        * This command returns the current pose of the robot TRF with respect to the WRF together with
+        * the time at which it has been received.
+        * @param float* pose: this is the array will contain the values requested.
+        * @param int64* timestamp: CLOCK_MONOTONIC_RAW time in ns of the process data exchange that carried the pose.
+        * @param int64* dc_time: if not null, it will contain the DC time in ns of the same exchange.
+        */
+        void getPoseStamped(float *pose, int64 *timestamp, int64 *dc_time = nullptr);
+
         /**
         * This command returns the status of the robot.
         * @param bool& as: activation state
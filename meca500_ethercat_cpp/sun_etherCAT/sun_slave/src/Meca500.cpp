@@ -388,6 +388,21 @@ namespace sun
         master->mutex_up();
     }
 
+    void Meca500::getPoseStamped(float *pose, int64 *timestamp, int64 *dc_time)
+    {
+        master->mutex_down();
+        pose[0] = out_MECA500->cartesian_position.x;
+        pose[1] = out_MECA500->cartesian_position.y;
+        pose[2] = out_MECA500->cartesian_position.z;
+        pose[3] = out_MECA500->cartesian_position.alpha;
+        pose[4] = out_MECA500->cartesian_position.beta;
+        pose[5] = out_MECA500->cartesian_position.gamma;
+        *timestamp = master->getExchangeTime();
+        if (dc_time != nullptr)
+            *dc_time = master->getExchangeDCTime();
+        master->mutex_up();
+    }
+
     void Meca500::getStatusRobot(bool &as, bool &hs, bool &sm, bool &es, bool &pm, bool &eob, bool &eom)
     {
         master->mutex_down();
@@ -1,49 +1,302 @@
+/*
+Latency benchmark for the DistanceSensor implementations.
+
+Every sample is the time spent in one getDistanceInMillimeters() call, measured with steady_clock.
+The first samples are discarded (warm-up), the others are summarised with percentiles and, for the
+infrared sensor, split in the write/wait/read phases of the serial transaction.
+With --rate=0 the sensor is read back-to-back and the throughput is the saturation rate.
+With --simulate the infrared sensor is replaced by a ProximitySimulator on a pseudo terminal, so the
+whole serial pipeline can be measured without the board.
+*/
+
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <unistd.h>
 #include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
 #include <math.h>
+#include "distance_sensor/include/DistanceSensor.hpp"
 #include "distance_sensor/include/InfraredSensor.hpp"
+#include "distance_sensor/include/UltrasonicSensor.hpp"
+#include "distance_sensor/include/ProximitySimulator.hpp"
 #include "csvlogger/CsvLogger.hpp"
 
-// Function to get current time in microseconds
-uint64_t getCurrentTimeMicros()
+#define SENSOR_COMMAND "sensor"           // sensor to benchmark [--sensor=infrared|ultrasonic]
+#define PORT_COMMAND "port"               // serial port of the infrared sensor, asked to the user if missing [--port=/dev/ttyUSB0]
+#define SAMPLES_COMMAND "samples"         // number of measured samples [--samples=COUNT]
+#define WARMUP_COMMAND "warmup"           // number of discarded samples before measuring [--warmup=COUNT]
+#define RATE_COMMAND "rate"               // sampling rate in Hz, 0 to read back-to-back [--rate=HZ]
+#define OUTPUT_COMMAND "output"           // csv file with the raw samples [--output=path/to/file.csv]
+#define SIMULATE_COMMAND "simulate"       // benchmark a simulated infrared sensor [--simulate or --simulate=PROFILE]
+#define SIM_LATENCY_COMMAND "sim_latency" // answer latency of the simulated sensor in micro seconds [--sim_latency=US]
+#define GPIO_COMMAND "gpio"               // GPIO backend of the ultrasonic sensor [--gpio=pigpio|gpiod|simulated:PROFILE]
+#define HELP_COMMAND "help"
+
+#define INFRARED_SENSOR_VALUE "infrared"
+#define ULTRASONIC_SENSOR_VALUE "ultrasonic"
+
+/* DEFAULT VALUES */
+#define SAMPLES_DEFAULT 1000
+#define WARMUP_DEFAULT 50
+#define RATE_DEFAULT 20 // Hz
+#define OUTPUT_DEFAULT "sensor_delay/ritardo_istruzione"
+#define ECHO_PIN 23 // default ECHO GPIO PIN for the ultrasonic sensor
+#define TRIG_PIN 22 // default TRIG GPIO PIN for the ultrasonic sensor
+
+#define message_length 16
+#define option_width 20
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct BenchmarkSample
 {
-    return std::chrono::duration_cast<std::chrono::microseconds>(
-               std::chrono::system_clock::now().time_since_epoch())
-        .count();
+    double latency_us; // duration of the whole getDistanceInMillimeters() call
+    double write_us;   // phases of the serial transaction (infrared only)
+    double wait_us;
+    double read_us;
+};
+
+map<string, string> parse_command_line(int argc, char *argv[]);
+void display_usage();
+vector<BenchmarkSample> run_benchmark(DistanceSensor &sensor, InfraredSensor *infrared, unsigned int samples, unsigned int warmup, double rate, double &elapsed_s, unsigned int &lost);
+double percentile(vector<double> values, double p);
+void print_summary(string name, vector<double> values);
+void write_samples_to_csv(const vector<BenchmarkSample> &samples, string file_path);
+
+int main(int argc, char *argv[])
+{
+    map<string, string> options = parse_command_line(argc, argv);
+    if (options.count(HELP_COMMAND) || !options.count(SENSOR_COMMAND))
+    {
+        display_usage();
+        return options.count(HELP_COMMAND) ? 0 : 1;
+    }
+
+    unsigned int samples = options.count(SAMPLES_COMMAND) ? stoul(options[SAMPLES_COMMAND]) : SAMPLES_DEFAULT;
+    unsigned int warmup = options.count(WARMUP_COMMAND) ? stoul(options[WARMUP_COMMAND]) : WARMUP_DEFAULT;
+    double rate = options.count(RATE_COMMAND) ? stod(options[RATE_COMMAND]) : RATE_DEFAULT;
+    string output = options.count(OUTPUT_COMMAND) ? options[OUTPUT_COMMAND] : OUTPUT_DEFAULT;
+
+    if (samples == 0 || rate < 0)
+    {
+        cerr << "Invalid number of samples or rate" << endl;
+        return 1;
+    }
+
+    DistanceSensor *sensor = nullptr;
+    InfraredSensor *infrared = nullptr;
+    ProximitySimulator *simulator = nullptr;
+    if (options.count(SIMULATE_COMMAND))
+    {
+        if (options[SENSOR_COMMAND] != INFRARED_SENSOR_VALUE)
+        {
+            cerr << "Only the infrared sensor can be simulated" << endl;
+            return 1;
+        }
+        SimulatorConfig_t config;
+        try
+        {
+            if (!options[SIMULATE_COMMAND].empty())
+                config.Profile = ProximitySimulator::parseProfile(options[SIMULATE_COMMAND]);
+            if (options.count(SIM_LATENCY_COMMAND))
+                config.LatencyUs = stoul(options[SIM_LATENCY_COMMAND]);
+        }
+        catch (const exception &e)
+        {
+            cerr << "Invalid simulator option: " << e.what() << endl;
+            return 1;
+        }
+        simulator = new ProximitySimulator(config);
+        simulator->start();
+        options[PORT_COMMAND] = simulator->getPortName();
+    }
+
+    if (options[SENSOR_COMMAND] == INFRARED_SENSOR_VALUE)
+    {
+        if (options.count(PORT_COMMAND))
+            infrared = new InfraredSensor(options[PORT_COMMAND]);
+        else
+            infrared = new InfraredSensor(InfraredSensor::USER_INPUT);
+        infrared->enableTransactionTiming(true);
+        sensor = infrared;
+    }
+    else if (options[SENSOR_COMMAND] == ULTRASONIC_SENSOR_VALUE)
+    {
+        try
+        {
+            sensor = new UltrasonicSensor(TRIG_PIN, ECHO_PIN, GpioBackend::create(options[GPIO_COMMAND]));
+        }
+        catch (const exception &e)
+        {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    else
+    {
+        cerr << "Invalid sensor type. Supported types: ultrasonic, infrared" << endl;
+        return 1;
+    }
+
+    cout << "Benchmarking " << options[SENSOR_COMMAND] << ": " << warmup << " warm-up + " << samples << " samples at "
+         << (rate > 0 ? to_string(rate) + " Hz" : string("saturation")) << endl;
+
+    double elapsed_s;
+    unsigned int lost;
+    vector<BenchmarkSample> results = run_benchmark(*sensor, infrared, samples, warmup, rate, elapsed_s, lost);
+
+    vector<double> latency, write, wait, read;
+    for (const BenchmarkSample &sample : results)
+    {
+        latency.push_back(sample.latency_us);
+        write.push_back(sample.write_us);
+        wait.push_back(sample.wait_us);
+        read.push_back(sample.read_us);
+    }
+
+    cout << endl
+         << left << setw(message_length) << "[us]" << right
+         << setw(10) << "mean" << setw(10) << "p50" << setw(10) << "p90" << setw(10) << "p99"
+         << setw(10) << "p99.9" << setw(10) << "max" << endl;
+    print_summary("latency", latency);
+    if (infrared != nullptr)
+    {
+        print_summary("  write", write);
+        print_summary("  wait", wait);
+        print_summary("  read", read);
+    }
+    cout << endl
+         << left << setw(message_length) << "throughput" << results.size() / elapsed_s << " samples/s" << endl
+         << left << setw(message_length) << "lost" << lost << " samples" << endl;
+
+    write_samples_to_csv(results, output);
+    cout << "Samples written to " << output << endl;
+
+    delete sensor;
+    delete simulator;
+    return 0;
 }
 
-void delayMicroseconds(uint64_t microseconds)
+vector<BenchmarkSample> run_benchmark(DistanceSensor &sensor, InfraredSensor *infrared, unsigned int samples, unsigned int warmup, double rate, double &elapsed_s, unsigned int &lost)
 {
-    auto start = std::chrono::high_resolution_clock::now();
-    auto end = start + std::chrono::microseconds(microseconds);
+    lost = 0;
+    vector<BenchmarkSample> results;
+    results.reserve(samples);
 
-    while (std::chrono::high_resolution_clock::now() < end)
+    Clock::duration period = rate > 0 ? chrono::duration_cast<Clock::duration>(chrono::duration<double>(1.0 / rate)) : Clock::duration::zero();
+    Clock::time_point next = Clock::now();
+    Clock::time_point first = next;
+
+    for (unsigned int i = 0; i < warmup + samples; i++)
     {
-        // Busy-wait loop
+        // absolute deadlines keep the rate without accumulating the sensor latency
+        if (rate > 0)
+        {
+            this_thread::sleep_until(next);
+            next += period;
+        }
+        if (i == warmup)
+            first = Clock::now();
+
+        Clock::time_point start = Clock::now();
+        float distance = sensor.getDistanceInMillimeters();
+        Clock::time_point end = Clock::now();
+
+        if (i < warmup)
+            continue;
+        if (distance < 0)
+            lost++; // timeout or incomplete frame, the latency is kept in the statistics
+
+        BenchmarkSample sample = {chrono::duration<double, micro>(end - start).count(), 0, 0, 0};
+        if (infrared != nullptr)
+        {
+            TransactionTiming timing = infrared->getLastTransactionTiming();
+            sample.write_us = timing.write_ns / 1e+3;
+            sample.wait_us = timing.wait_ns / 1e+3;
+            sample.read_us = timing.read_ns / 1e+3;
+        }
+        results.push_back(sample);
     }
+
+    elapsed_s = chrono::duration<double>(Clock::now() - first).count();
+    return results;
 }
 
-int main()
+double percentile(vector<double> values, double p)
 {
-    InfraredSensor sensor(InfraredSensor::USER_INPUT);
+    // nearest-rank percentile
+    if (values.empty())
+        return 0;
+    size_t rank = (size_t)ceil(p / 100.0 * values.size());
+    rank = rank > 0 ? rank - 1 : 0;
+    nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
 
-    uint64_t currentTime, t;
-    /*files to write, setup*/
-    CsvLogger output_logger("delay/ritardo_istruzione");
-    output_logger.write("value\n");
+void print_summary(string name, vector<double> values)
+{
+    double mean = 0;
+    for (double value : values)
+        mean += value;
+    mean /= values.empty() ? 1 : values.size();
 
-    for (int i = 0; i < 100; i++)
+    cout << left << setw(message_length) << name << right << fixed << setprecision(1)
+         << setw(10) << mean
+         << setw(10) << percentile(values, 50)
+         << setw(10) << percentile(values, 90)
+         << setw(10) << percentile(values, 99)
+         << setw(10) << percentile(values, 99.9)
+         << setw(10) << *max_element(values.begin(), values.end()) << endl;
+}
+
+void write_samples_to_csv(const vector<BenchmarkSample> &samples, string file_path)
+{
+    CsvLogger output_logger(file_path);
+    output_logger.write("latency,write,wait,read\n");
+    for (const BenchmarkSample &sample : samples)
     {
-        currentTime = getCurrentTimeMicros();
-        sensor.getDistanceInMillimeters();
-        t = getCurrentTimeMicros() - currentTime;
-        output_logger << t;
+        output_logger << sample.latency_us << sample.write_us << sample.wait_us << sample.read_us;
         output_logger.end_row();
-        delayMicroseconds(0.05*1e6);
     }
-
     output_logger.close();
+}
 
-    return 0;
+map<string, string> parse_command_line(int argc, char *argv[])
+{
+    map<string, string> options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "--")
+        {
+            size_t pos = arg.find('=');
+            string command = pos != string::npos ? arg.substr(2, pos - 2) : arg.substr(2);
+            options[command] = pos != string::npos ? arg.substr(pos + 1) : "";
+        }
+    }
+
+    return options;
+}
+
+void display_usage()
+{
+    cout << "Usage: ./ritardo --" << SENSOR_COMMAND << "=TYPE [OPTIONS]" << endl
+         << "Options:" << endl
+         << left
+         << "  --" << setw(option_width) << SENSOR_COMMAND "=TYPE" << "Sensor to benchmark (infrared, ultrasonic)" << endl
+         << "  --" << setw(option_width) << PORT_COMMAND "=PATH" << "Serial port of the infrared sensor [default: ask the user]" << endl
+         << "  --" << setw(option_width) << SAMPLES_COMMAND "=COUNT" << "Number of measured samples [default " << SAMPLES_DEFAULT << "]" << endl
+         << "  --" << setw(option_width) << WARMUP_COMMAND "=COUNT" << "Number of discarded samples [default " << WARMUP_DEFAULT << "]" << endl
+         << "  --" << setw(option_width) << RATE_COMMAND "=HZ" << "Sampling rate, 0 for back-to-back reads [default " << RATE_DEFAULT << "]" << endl
+         << "  --" << setw(option_width) << OUTPUT_COMMAND "=PATH" << "Csv file with the samples [default " << OUTPUT_DEFAULT << "]" << endl
+         << "  --" << setw(option_width) << SIMULATE_COMMAND "[=PROFILE]" << "Use a simulated infrared sensor (see ./simulatore --help for the profiles)" << endl
+         << "  --" << setw(option_width) << SIM_LATENCY_COMMAND "=US" << "Answer latency of the simulated sensor [default 0]" << endl
+         << "  --" << setw(option_width) << GPIO_COMMAND "=BACKEND" << "GPIO backend of the ultrasonic sensor: pigpio, gpiod[:/dev/gpiochipN], simulated[:PROFILE[@NOISE]]" << endl;
 }
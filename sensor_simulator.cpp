@@ -0,0 +1,130 @@
+/*
+Simulator of the proximity sensor board on a pseudo terminal.
+
+The program prints the path of the simulated serial port, which can be passed to the other
+programs (i.e. ./ritardo --sensor=infrared --port=/dev/pts/3) in place of a real /dev/ttyUSB* device.
+It runs until it's stopped with Ctrl+C.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <csignal>
+#include <unistd.h>
+#include "distance_sensor/include/ProximitySimulator.hpp"
+
+#define NAME_COMMAND "name"         // answer to the handshake [--name=P001]
+#define ELEMENTS_COMMAND "elements" // number of sensing elements [--elements=COUNT]
+#define LATENCY_COMMAND "latency"   // answer latency in micro seconds [--latency=US]
+#define JITTER_COMMAND "jitter"     // uniform jitter added to the latency in micro seconds [--jitter=US]
+#define NOISE_COMMAND "noise"       // standard deviation of the gaussian noise in mm [--noise=MM]
+#define DROP_COMMAND "drop"         // probability of dropping each byte of an answer [--drop=P]
+#define PROFILE_COMMAND "profile"   // distance profile [--profile=constant:100|ramp:MIN,MAX,PERIOD|sine:MEAN,AMPLITUDE,PERIOD]
+#define HELP_COMMAND "help"
+
+#define STATUS_PERIOD_S 5 // period of the served requests report
+
+#define option_width 30
+
+using namespace std;
+
+volatile sig_atomic_t running = 1;
+
+map<string, string> parse_command_line(int argc, char *argv[]);
+void display_usage();
+
+void handle_signal(int)
+{
+    running = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    map<string, string> options = parse_command_line(argc, argv);
+    if (options.count(HELP_COMMAND))
+    {
+        display_usage();
+        return 0;
+    }
+
+    SimulatorConfig_t config;
+    try
+    {
+        if (options.count(NAME_COMMAND))
+            config.SensorName = options[NAME_COMMAND];
+        if (options.count(ELEMENTS_COMMAND))
+            config.NumSensingElements = stoul(options[ELEMENTS_COMMAND]);
+        if (options.count(LATENCY_COMMAND))
+            config.LatencyUs = stoul(options[LATENCY_COMMAND]);
+        if (options.count(JITTER_COMMAND))
+            config.LatencyJitterUs = stoul(options[JITTER_COMMAND]);
+        if (options.count(NOISE_COMMAND))
+            config.NoiseMm = stof(options[NOISE_COMMAND]);
+        if (options.count(DROP_COMMAND))
+            config.DropProbability = stod(options[DROP_COMMAND]);
+        if (options.count(PROFILE_COMMAND))
+            config.Profile = ProximitySimulator::parseProfile(options[PROFILE_COMMAND]);
+    }
+    catch (const exception &e)
+    {
+        cerr << "Invalid option: " << e.what() << endl;
+        return 1;
+    }
+
+    if (config.SensorName.size() != 4 || config.NumSensingElements == 0 || config.DropProbability < 0 || config.DropProbability > 1)
+    {
+        cerr << "The name must be 4 characters long, at least one sensing element is needed and the drop probability must be in [0, 1]" << endl;
+        return 1;
+    }
+
+    ProximitySimulator simulator(config);
+    simulator.start();
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    cout << "Simulated sensor " << config.SensorName << " on " << simulator.getPortName() << endl
+         << "Press Ctrl+C to stop" << endl;
+
+    while (running)
+    {
+        sleep(STATUS_PERIOD_S);
+        cout << "Requests served: " << simulator.getRequestsServed() << endl;
+    }
+
+    simulator.stop();
+    return 0;
+}
+
+map<string, string> parse_command_line(int argc, char *argv[])
+{
+    map<string, string> options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "--")
+        {
+            size_t pos = arg.find('=');
+            string command = pos != string::npos ? arg.substr(2, pos - 2) : arg.substr(2);
+            options[command] = pos != string::npos ? arg.substr(pos + 1) : "";
+        }
+    }
+
+    return options;
+}
+
+void display_usage()
+{
+    cout << "Usage: ./simulatore [OPTIONS]" << endl
+         << "Options:" << endl
+         << left
+         << "  --" << setw(option_width) << NAME_COMMAND "=NAME" << "Sensor name sent in the handshake [default P001]" << endl
+         << "  --" << setw(option_width) << ELEMENTS_COMMAND "=COUNT" << "Number of sensing elements [default 1]" << endl
+         << "  --" << setw(option_width) << LATENCY_COMMAND "=US" << "Answer latency in micro seconds [default 0]" << endl
+         << "  --" << setw(option_width) << JITTER_COMMAND "=US" << "Random jitter added to the latency [default 0]" << endl
+         << "  --" << setw(option_width) << NOISE_COMMAND "=MM" << "Standard deviation of the reading noise [default 0]" << endl
+         << "  --" << setw(option_width) << DROP_COMMAND "=P" << "Probability of dropping each answer byte [default 0]" << endl
+         << "  --" << setw(option_width) << PROFILE_COMMAND "=PROFILE" << "constant:D, ramp:MIN,MAX,PERIOD or sine:MEAN,AMPLITUDE,PERIOD [default constant:100]" << endl;
+}
@@ -0,0 +1,258 @@
+#include "Statistics.hpp"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace statistics
+{
+    double normalQuantile(double p)
+    {
+        // rational approximation of P. J. Acklam, relative error below 1.2e-9
+        static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                   1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+        static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                   6.680131188771972e+01, -1.328068155288572e+01};
+        static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                   -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+        static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                   3.754408661907416e+00};
+        const double p_low = 0.02425;
+
+        if (p <= 0)
+            return -std::numeric_limits<double>::infinity();
+        if (p >= 1)
+            return std::numeric_limits<double>::infinity();
+
+        if (p < p_low || p > 1 - p_low)
+        {
+            double q = std::sqrt(-2 * std::log(p < p_low ? p : 1 - p));
+            double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+                       ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+            return p < p_low ? x : -x;
+        }
+
+        double q = p - 0.5;
+        double r = q * q;
+        return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+               (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+    }
+
+    double studentQuantile(double p, double degrees_of_freedom)
+    {
+        // Abramowitz and Stegun 26.7.5
+        double z = normalQuantile(p);
+        double v = degrees_of_freedom;
+        double z2 = z * z;
+        double g1 = (z2 + 1) * z / 4;
+        double g2 = ((5 * z2 + 16) * z2 + 3) * z / 96;
+        double g3 = (((3 * z2 + 19) * z2 + 17) * z2 - 15) * z / 384;
+        double g4 = ((((79 * z2 + 776) * z2 + 1482) * z2 - 1920) * z2 - 945) * z / 92160;
+        return z + (g1 + (g2 + (g3 + g4 / v) / v) / v) / v;
+    }
+
+    /* RunningStats */
+    void RunningStats::add(double value)
+    {
+        n++;
+        if (n == 1)
+        {
+            minimum = maximum = value;
+        }
+        else
+        {
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+        double delta = value - m;
+        m += delta / n;
+        m2 += delta * (value - m);
+    }
+
+    void RunningStats::merge(const RunningStats &other)
+    {
+        if (other.n == 0)
+            return;
+        if (n == 0)
+        {
+            *this = other;
+            return;
+        }
+        uint64_t total = n + other.n;
+        double delta = other.m - m;
+        m += delta * other.n / total;
+        m2 += other.m2 + delta * delta * ((double)n * other.n / total);
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        n = total;
+    }
+
+    void RunningStats::reset()
+    {
+        *this = RunningStats();
+    }
+
+    RunningStats RunningStats::fromMoments(uint64_t count, double mean, double squared_deviations, double min, double max)
+    {
+        RunningStats stats;
+        if (count == 0)
+            return stats;
+        stats.n = count;
+        stats.m = mean;
+        stats.m2 = squared_deviations;
+        stats.minimum = min;
+        stats.maximum = max;
+        return stats;
+    }
+
+    uint64_t RunningStats::count() const
+    {
+        return n;
+    }
+
+    double RunningStats::mean() const
+    {
+        return m;
+    }
+
+    double RunningStats::min() const
+    {
+        return minimum;
+    }
+
+    double RunningStats::max() const
+    {
+        return maximum;
+    }
+
+    double RunningStats::squaredDeviations() const
+    {
+        return m2;
+    }
+
+    double RunningStats::variance() const
+    {
+        return n > 1 ? m2 / (n - 1) : 0;
+    }
+
+    double RunningStats::stddev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    double RunningStats::standardError() const
+    {
+        return n > 0 ? stddev() / std::sqrt((double)n) : 0;
+    }
+
+    double RunningStats::confidenceHalfWidth(double confidence) const
+    {
+        if (n < 2)
+            return std::numeric_limits<double>::infinity();
+        return studentQuantile(0.5 + confidence / 2, n - 1) * standardError();
+    }
+
+    /* QuantileSketch */
+    QuantileSketch::QuantileSketch(double p) : p(p)
+    {
+        for (int i = 0; i < 5; i++)
+            positions[i] = i + 1;
+        desired[0] = 1;
+        desired[1] = 1 + 2 * p;
+        desired[2] = 1 + 4 * p;
+        desired[3] = 3 + 2 * p;
+        desired[4] = 5;
+        increments[0] = 0;
+        increments[1] = p / 2;
+        increments[2] = p;
+        increments[3] = (1 + p) / 2;
+        increments[4] = 1;
+    }
+
+    void QuantileSketch::add(double value)
+    {
+        if (n < 5)
+        {
+            // the first five values are kept sorted
+            int i = n++;
+            while (i > 0 && heights[i - 1] > value)
+            {
+                heights[i] = heights[i - 1];
+                i--;
+            }
+            heights[i] = value;
+            return;
+        }
+        n++;
+
+        // cell of the new value, extending the extreme markers if needed
+        int k;
+        if (value < heights[0])
+        {
+            heights[0] = value;
+            k = 0;
+        }
+        else if (value >= heights[4])
+        {
+            heights[4] = std::max(heights[4], value);
+            k = 3;
+        }
+        else
+        {
+            k = 0;
+            while (value >= heights[k + 1])
+                k++;
+        }
+
+        for (int i = k + 1; i < 5; i++)
+            positions[i]++;
+        for (int i = 0; i < 5; i++)
+            desired[i] += increments[i];
+
+        // moves the middle markers towards their desired positions
+        for (int i = 1; i < 4; i++)
+        {
+            double offset = desired[i] - positions[i];
+            if ((offset >= 1 && positions[i + 1] - positions[i] > 1) || (offset <= -1 && positions[i - 1] - positions[i] < -1))
+            {
+                int d = offset > 0 ? 1 : -1;
+                double height = parabolic(i, d);
+                if (heights[i - 1] < height && height < heights[i + 1])
+                    heights[i] = height;
+                else
+                    heights[i] = linear(i, d);
+                positions[i] += d;
+            }
+        }
+    }
+
+    uint64_t QuantileSketch::count() const
+    {
+        return n;
+    }
+
+    double QuantileSketch::value() const
+    {
+        if (n == 0)
+            return 0;
+        if (n <= 5)
+        {
+            // exact quantile of the sorted values, nearest rank
+            int rank = (int)std::lround(p * (n - 1));
+            return heights[rank];
+        }
+        return heights[2];
+    }
+
+    double QuantileSketch::parabolic(int i, int d) const
+    {
+        return heights[i] + d / (positions[i + 1] - positions[i - 1]) *
+                                ((positions[i] - positions[i - 1] + d) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+                                 (positions[i + 1] - positions[i] - d) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+    }
+
+    double QuantileSketch::linear(int i, int d) const
+    {
+        return heights[i] + d * (heights[i + d] - heights[i]) / (positions[i + d] - positions[i]);
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Streaming statistics of the measurements: every value is seen once and the memory doesn't grow with the
+ * number of values, so the estimates can be checked while the sensor is still being sampled.
+ */
+namespace statistics
+{
+    /**
+     * Quantile of the standard normal distribution, p in (0, 1).
+     */
+    double normalQuantile(double p);
+
+    /**
+     * Quantile of the Student t distribution with the given degrees of freedom, p in (0, 1).
+     * Cornish-Fisher expansion around the normal quantile, error below 0.1% from 4 degrees of freedom.
+     */
+    double studentQuantile(double p, double degrees_of_freedom);
+
+    /**
+     * Count, mean, variance, minimum and maximum of a stream of values (Welford's algorithm, stable also
+     * when the variance is small compared with the mean).
+     */
+    class RunningStats
+    {
+    private:
+        uint64_t n = 0;
+        double m = 0;  // running mean
+        double m2 = 0; // sum of the squared differences from the mean
+        double minimum = 0;
+        double maximum = 0;
+
+    public:
+        void add(double value);
+
+        /**
+         * Adds the values of another stream (Chan's parallel update), i.e. to join the statistics of
+         * different threads.
+         */
+        void merge(const RunningStats &other);
+
+        void reset();
+
+        /**
+         * Restores the statistics saved with count(), mean(), squaredDeviations(), min() and max(),
+         * i.e. the partial results of a file kept in a cache.
+         */
+        static RunningStats fromMoments(uint64_t count, double mean, double squared_deviations, double min, double max);
+
+        uint64_t count() const;
+        double mean() const;
+        double min() const;
+        double max() const;
+
+        /**
+         * Sum of the squared differences from the mean, the sum of squares without the cancellation of
+         * sum(x^2) - sum(x)^2 / n.
+         */
+        double squaredDeviations() const;
+
+        /**
+         * Sample variance (n - 1 at the denominator), 0 with less than two values.
+         */
+        double variance() const;
+        double stddev() const;
+
+        /**
+         * Standard error of the mean, stddev / sqrt(n).
+         */
+        double standardError() const;
+
+        /**
+         * Half width of the two-sided confidence interval on the mean at the given level (Student t),
+         * infinite with less than two values.
+         */
+        double confidenceHalfWidth(double confidence = 0.95) const;
+    };
+
+    /**
+     * Estimate of a quantile of a stream with five markers (P-square algorithm, Jain and Chlamtac 1985).
+     * It's exact up to five values, then the markers are moved with a parabolic interpolation.
+     */
+    class QuantileSketch
+    {
+    private:
+        double p;
+        uint64_t n = 0;
+        double heights[5];   // marker heights, the estimated quantile is heights[2]
+        double positions[5]; // actual marker positions, 1 based
+        double desired[5];   // desired marker positions
+        double increments[5];
+
+        double parabolic(int i, int d) const;
+        double linear(int i, int d) const;
+
+    public:
+        QuantileSketch(double p = 0.5);
+
+        void add(double value);
+        uint64_t count() const;
+
+        /**
+         * Current estimate of the quantile, 0 if no value has been added
+         */
+        double value() const;
+    };
+}
+
+#endif // STATISTICS_HPP
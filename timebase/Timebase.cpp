@@ -0,0 +1,135 @@
+#include "Timebase.hpp"
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_USEC 1000LL
+
+namespace timebase
+{
+    int64_t now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+    }
+
+    /*TICK CLOCK*/
+    TickClock::TickClock(std::function<uint32_t()> tick_source, int64_t resync_period_ns)
+        : tick_source(tick_source),
+          resync_period_ns(resync_period_ns)
+    {
+        synchronise();
+    }
+
+    void TickClock::synchronise()
+    {
+        // the tick is read between two timeline samples and assigned to their midpoint
+        int64_t before = now();
+        uint32_t tick = tick_source();
+        int64_t after = now();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        reference_tick = tick;
+        reference_time = before + (after - before) / 2;
+    }
+
+    int64_t TickClock::toTimeline(uint32_t tick)
+    {
+        if (now() - reference_time > resync_period_ns)
+            synchronise();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        // unsigned difference casted to signed handles the wrap around of the counter
+        int32_t elapsed_us = (int32_t)(tick - reference_tick);
+        return reference_time + elapsed_us * NSEC_PER_USEC;
+    }
+
+    /*DC CLOCK*/
+    DcClock::DcClock(size_t window, size_t update_period)
+        : update_period(update_period)
+    {
+        pairs.reserve(window > 1 ? window : 2);
+    }
+
+    void DcClock::addSample(int64_t dc_time, int64_t timeline)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!has_reference)
+        {
+            reference_dc = dc_time;
+            reference_timeline = timeline;
+            has_reference = true;
+        }
+
+        Pair pair;
+        pair.timeline = (double)(timeline - reference_timeline);
+        pair.offset = (double)(dc_time - reference_dc) - pair.timeline;
+
+        if (pairs.size() < pairs.capacity())
+            pairs.push_back(pair);
+        else
+            pairs[next_pair] = pair;
+        next_pair = (next_pair + 1) % pairs.capacity();
+
+        if (++pairs_since_update >= update_period || !estimated)
+            update_estimate();
+    }
+
+    void DcClock::update_estimate()
+    {
+        // least squares line offset = offset + drift * timeline on the stored pairs
+        size_t n = pairs.size();
+        if (n < 2)
+        {
+            offset = n == 1 ? pairs[0].offset : 0;
+            return;
+        }
+
+        double mean_t = 0, mean_o = 0;
+        for (const Pair &pair : pairs)
+        {
+            mean_t += pair.timeline;
+            mean_o += pair.offset;
+        }
+        mean_t /= n;
+        mean_o /= n;
+
+        double s_to = 0, s_tt = 0;
+        for (const Pair &pair : pairs)
+        {
+            s_to += (pair.timeline - mean_t) * (pair.offset - mean_o);
+            s_tt += (pair.timeline - mean_t) * (pair.timeline - mean_t);
+        }
+        drift = s_tt > 0 ? s_to / s_tt : 0;
+        offset = mean_o - drift * mean_t;
+        pairs_since_update = 0;
+        estimated = true;
+    }
+
+    int64_t DcClock::toTimeline(int64_t dc_time) const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        // dc - ref_dc = t + offset + drift * t  =>  t = (dc - ref_dc - offset) / (1 + drift)
+        double t = ((double)(dc_time - reference_dc) - offset) / (1.0 + drift);
+        return reference_timeline + (int64_t)t;
+    }
+
+    int64_t DcClock::toDcTime(int64_t timeline) const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        double t = (double)(timeline - reference_timeline);
+        return reference_dc + (int64_t)(t + offset + drift * t);
+    }
+
+    double DcClock::driftPpm() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return drift * 1e+6;
+    }
+
+    bool DcClock::isSynchronised() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return estimated;
+    }
+} // namespace timebase
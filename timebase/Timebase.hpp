@@ -0,0 +1,109 @@
+#ifndef TIMEBASE_HPP
+#define TIMEBASE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <functional>
+
+/**
+ * Common timeline for every clock of the calibration bench.
+ * All the timestamps are nanoseconds of CLOCK_MONOTONIC_RAW, which is not slewed by NTP, so the samples of the
+ * serial sensors, the GPIO sensors and the EtherCAT frames can be compared with each other.
+ */
+namespace timebase
+{
+    /**
+     * Returns the current time on the common timeline in nanoseconds.
+     */
+    int64_t now();
+
+    /**
+     * Maps a 32 bit microsecond tick counter (i.e. the tick of a GPIO backend) onto the timeline.
+     * The tick wraps every ~72 minutes, so the reference pair is refreshed every resync_period_ns.
+     */
+    class TickClock
+    {
+    private:
+        std::function<uint32_t()> tick_source;
+        int64_t resync_period_ns;
+        uint32_t reference_tick;
+        int64_t reference_time;
+        std::mutex mtx;
+
+    public:
+        TickClock(std::function<uint32_t()> tick_source, int64_t resync_period_ns = 1000000000);
+
+        /**
+         * Samples the tick source and the timeline together to update the reference pair.
+         */
+        void synchronise();
+
+        /**
+         * Converts a tick read from the tick source to a timeline timestamp in nanoseconds.
+         * Ticks up to ~35 minutes before or after the reference are converted correctly.
+         */
+        int64_t toTimeline(uint32_t tick);
+    };
+
+    /**
+     * Estimates offset and drift of the EtherCAT distributed clock (ec_DCtime) against the timeline.
+     * Every process data exchange gives a (DC time, timeline) pair; a least squares line is fitted on the
+     * last `window` pairs every `update_period` pairs.
+     */
+    class DcClock
+    {
+    private:
+        struct Pair
+        {
+            double timeline; // timeline - reference_timeline [ns]
+            double offset;   // (dc - reference_dc) - (timeline - reference_timeline) [ns]
+        };
+
+        std::vector<Pair> pairs;
+        size_t next_pair = 0;
+        size_t pairs_since_update = 0;
+        size_t update_period;
+        bool has_reference = false;
+        bool estimated = false;
+        int64_t reference_dc = 0;
+        int64_t reference_timeline = 0;
+        double offset = 0; // estimated offset at the reference [ns]
+        double drift = 0;  // estimated drift [ns/ns]
+        mutable std::mutex mtx;
+
+        void update_estimate();
+
+    public:
+        DcClock(size_t window = 1000, size_t update_period = 100);
+
+        /**
+         * Adds the DC time of a process data exchange together with its timeline timestamp.
+         * Meant to be called by the EtherCAT cyclic thread after every exchange.
+         */
+        void addSample(int64_t dc_time, int64_t timeline);
+
+        /**
+         * Converts a DC time to a timeline timestamp in nanoseconds.
+         */
+        int64_t toTimeline(int64_t dc_time) const;
+
+        /**
+         * Converts a timeline timestamp to DC time in nanoseconds.
+         */
+        int64_t toDcTime(int64_t timeline) const;
+
+        /**
+         * Returns the estimated drift of the DC clock against the timeline in parts per million.
+         */
+        double driftPpm() const;
+
+        /**
+         * Returns true once at least one estimate has been computed.
+         */
+        bool isSynchronised() const;
+    };
+} // namespace timebase
+
+#endif
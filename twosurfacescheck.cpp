@@ -1,79 +1,419 @@
 /*
-MECA moves sensor, measuring the same distance between two different surfaces: 
+MECA moves sensor, measuring the same distance between two different surfaces:
 - alluminium
 - black flimsy paper
 
 the target is to check the dipendence from the surface
+
+The poses and the samples taken at each pose come from a plan file (see --plan and twosurfaces_test/plan.txt),
+by default the original experiment: the two surfaces at z 230 and 50, 6 times each, 500 samples every 200 us.
+Every pose has its own streaming statistics; its samples and summary are written by a writer thread while the
+robot moves to the next pose, in results.csv (one row per pose, read by twosurfacestest.py) and samples.csv.
 */
 
 #include "distance_sensor/include/DistanceSensor.hpp"
 #include "distance_sensor/include/UltrasonicSensor.hpp"
 #include "distance_sensor/include/InfraredSensor.hpp"
 #include "meca500_ethercat_cpp/Robot.hpp"
+#include "statistics/Statistics.hpp"
 #include <stdio.h>
 #include <iomanip>
 #include <unistd.h>
 #include <iostream>
+#include <fstream>
 #include <sstream>
+#include <filesystem>
 #include <time.h>
 #include <vector>
+#include <deque>
 #include <cstring>
 #include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define SENSOR_COMMAND "sensor"   // sensor to use [--sensor=infrared|ultrasonic]
+#define PLAN_COMMAND "plan"       // poses and samples of the experiment [--plan=FILE]
+#define PORT_COMMAND "port"       // serial port of the infrared sensor [--port=/dev/ttyUSB0]
+#define GPIO_COMMAND "gpio"       // GPIO backend of the ultrasonic sensor [--gpio=pigpio|gpiod|simulated:PROFILE]
+#define OUTPUT_COMMAND "output"   // folder of results.csv and samples.csv [--output=FOLDER]
+#define NOROBOT_COMMAND "norobot" // the poses are set by hand instead of moving the meca500 [--norobot]
+#define HELP_COMMAND "help"
+
+#define INFRARED_SENSOR_VALUE "infrared"
+#define ULTRASONIC_SENSOR_VALUE "ultrasonic"
+
+/* DEFAULT VALUES */
+#define SAMPLES_DEFAULT 500
+#define DELAY_US_DEFAULT 200
+#define SETTLE_MS_DEFAULT 0
+#define OUTPUT_DEFAULT "twosurfaces_test"
+#define ECHO_PIN 23 // default ECHO GPIO PIN for the ultrasonic sensor
+#define TRIG_PIN 22 // default TRIG GPIO PIN for the ultrasonic sensor
+#define CONFIDENCE 0.95
+
+#define option_width 20
 
 using namespace std;
 
-void make_measurements(DistanceSensor &sensor, int number_of_measurements, vector<float> &measurements, unsigned int delay_us);
+// A pose of the plan and how it's measured
+struct PosePlan
+{
+    string label;
+    float pose[6];          // x, y, z, alpha, beta, gamma of the meca500
+    unsigned int samples;   // samples taken at the pose
+    unsigned int delay_us;  // delay between two samples
+    unsigned int settle_ms; // wait after the motion before sampling
+};
 
+// Measurements of a pose, handed to the writer thread
+struct PoseResult
+{
+    size_t index;
+    PosePlan plan;
+    statistics::RunningStats stats; // valid samples only, failed readings (-1) are excluded
+    statistics::QuantileSketch median;
+    vector<DistanceSample> samples;
+};
+
+// Writes the results of the poses in the background, in the order they are queued
+class ResultWriter
+{
+private:
+    ofstream results, samples;
+    deque<PoseResult> queue;
+    mutex queue_mutex;
+    condition_variable queue_condition;
+    bool closing = false;
+    thread worker;
+
+    void work();
+    void write(const PoseResult &result);
+
+public:
+    ResultWriter(const string &folder);
+    ~ResultWriter();
+    void push(PoseResult result);
+    // Writes the queued results and stops the thread
+    void close();
+};
+
+map<string, string> parse_command_line(int argc, char *argv[]);
+void display_usage();
+vector<PosePlan> default_plan();
+vector<PosePlan> parse_plan(const string &path);
+PoseResult measure_pose(DistanceSensor &sensor, size_t index, const PosePlan &plan);
 
 int main(int argc, char *argv[])
 {
-    /*setup meca*/
-    InfraredSensor sensor(InfraredSensor::ENABLE_ALL);
-    Robot robot(100, 200, 5000, "eth0", 0.0, 10);
-    robot.reset_error();
-    // robot.main();
-    robot.set_conf(1, 1, -1);
-    robot.move_pose(130, -180, 230, 90, 90, 0);
+    map<string, string> options = parse_command_line(argc, argv);
+    if (options.count(HELP_COMMAND))
+    {
+        display_usage();
+        return 0;
+    }
+    string sensor_name = options.count(SENSOR_COMMAND) ? options[SENSOR_COMMAND] : INFRARED_SENSOR_VALUE;
+    string output = options.count(OUTPUT_COMMAND) ? options[OUTPUT_COMMAND] : OUTPUT_DEFAULT;
+    bool use_robot = !options.count(NOROBOT_COMMAND);
+
+    // the whole plan is validated before the sensor and the robot are touched
+    vector<PosePlan> plan;
+    try
+    {
+        plan = options.count(PLAN_COMMAND) ? parse_plan(options[PLAN_COMMAND]) : default_plan();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Invalid plan: " << e.what() << endl;
+        return 1;
+    }
+
+    DistanceSensor *sensor = nullptr;
+    if (sensor_name == INFRARED_SENSOR_VALUE)
+    {
+        if (options.count(PORT_COMMAND))
+            sensor = new InfraredSensor(options[PORT_COMMAND]);
+        else
+            sensor = new InfraredSensor(InfraredSensor::ENABLE_ALL);
+    }
+    else if (sensor_name == ULTRASONIC_SENSOR_VALUE)
+    {
+        try
+        {
+            sensor = new UltrasonicSensor(TRIG_PIN, ECHO_PIN, GpioBackend::create(options[GPIO_COMMAND]));
+        }
+        catch (const exception &e)
+        {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    else
+    {
+        cerr << "Invalid sensor type. Supported types: ultrasonic, infrared" << endl;
+        return 1;
+    }
 
-    robot.print_pose();
-    float velocity[6] = {0, 0, 0, 0, 0, 0};
-    float position[6];
+    ResultWriter *writer;
+    try
+    {
+        writer = new ResultWriter(output);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    /*setup meca*/
+    Robot *robot = nullptr;
+    if (use_robot)
+    {
+        robot = new Robot(100, 200, 5000, "eth0", 0.0, 10);
+        robot->reset_error();
+        robot->set_conf(1, 1, -1);
+    }
 
     /*start process*/
-    float values[12];
-    float height = 230;
-    vector<float> measurements;
+    for (size_t i = 0; i < plan.size(); i++)
+    {
+        const float *pose = plan[i].pose;
+        cout << "Pose " << i << " (" << plan[i].label << "): " << pose[0] << ", " << pose[1] << ", " << pose[2] << ", "
+             << pose[3] << ", " << pose[4] << ", " << pose[5] << endl;
+        // the writer saves the previous pose while the robot moves to this one
+        if (use_robot)
+        {
+            robot->move_pose(pose[0], pose[1], pose[2], pose[3], pose[4], pose[5]);
+        }
+        else
+        {
+            cout << "Please position the surface " << plan[i].label << " in front of the sensor" << endl
+                 << "Press enter to continue..." << endl;
+            getchar();
+        }
+        usleep(plan[i].settle_ms * 1000);
+        writer->push(measure_pose(*sensor, i, plan[i]));
+    }
+    writer->close();
+    cout << "Results written to " << output << endl;
+
+    delete writer;
+    delete robot;
+    delete sensor;
+    return 0;
+}
 
+PoseResult measure_pose(DistanceSensor &sensor, size_t index, const PosePlan &plan)
+{
+    PoseResult result = {index, plan, {}, statistics::QuantileSketch(0.5), {}};
+    result.samples.reserve(plan.samples);
+    for (unsigned int i = 0; i < plan.samples; i++)
+    {
+        DistanceSample sample = sensor.sampleInMillimeters();
+        result.samples.push_back(sample);
+        if (sample.distance_mm >= 0)
+        {
+            result.stats.add(sample.distance_mm);
+            result.median.add(sample.distance_mm);
+        }
+        usleep(plan.delay_us);
+    }
+    return result;
+}
+
+vector<PosePlan> default_plan()
+{
+    vector<PosePlan> plan;
     for (int i = 0; i < 12; i++)
     {
-        height = 230 - (i % 2) * 180; //pos1: 230, pos2: 50
-        robot.move_pose(130, -180, height, 90, 90, 0);
+        float height = 230 - (i % 2) * 180; // pos1: 230, pos2: 50
+        plan.push_back({i % 2 ? "basso" : "alto", {130, -180, height, 90, 90, 0}, SAMPLES_DEFAULT, DELAY_US_DEFAULT, SETTLE_MS_DEFAULT});
+    }
+    return plan;
+}
+
+/*
+Plan file, one key=value per line, "#" starts a comment:
+    samples=500                         samples, delay (us) and settle time (ms) of the poses that follow
+    delay=200
+    settle=0
+    pose=alto:130,-180,230,90,90,0      pose of the meca500, the label before ":" is optional
+    repeat=6                            the whole list of poses is measured this many times
+*/
+vector<PosePlan> parse_plan(const string &path)
+{
+    ifstream file(path);
+    if (!file.is_open())
+        throw runtime_error("cannot open " + path);
 
-        make_measurements(sensor, 500, measurements, 200);
-        float average = 0;
-        for (float m : measurements)
+    vector<PosePlan> poses;
+    unsigned int samples = SAMPLES_DEFAULT, delay_us = DELAY_US_DEFAULT, settle_ms = SETTLE_MS_DEFAULT, repeat = 1;
+    string row;
+    for (int line = 1; getline(file, row); line++)
+    {
+        row = row.substr(0, row.find('#'));
+        row.erase(0, row.find_first_not_of(" \t\r"));
+        row.erase(row.find_last_not_of(" \t\r") + 1);
+        if (row.empty())
+            continue;
+
+        size_t pos = row.find('=');
+        string key = row.substr(0, pos), value = pos != string::npos ? row.substr(pos + 1) : "";
+        try
+        {
+            if (key == "samples")
+                samples = stoul(value);
+            else if (key == "delay")
+                delay_us = stoul(value);
+            else if (key == "settle")
+                settle_ms = stoul(value);
+            else if (key == "repeat")
+                repeat = stoul(value);
+            else if (key == "pose")
+            {
+                PosePlan plan = {"pose " + to_string(poses.size()), {}, samples, delay_us, settle_ms};
+                size_t colon = value.find(':');
+                if (colon != string::npos)
+                {
+                    plan.label = value.substr(0, colon);
+                    value = value.substr(colon + 1);
+                }
+                stringstream values(value);
+                string item;
+                int count = 0;
+                for (; getline(values, item, ','); count++)
+                {
+                    if (count < 6)
+                        plan.pose[count] = stof(item);
+                }
+                if (count != 6)
+                    throw invalid_argument("6 coordinates expected");
+                poses.push_back(plan);
+            }
+            else
+                throw invalid_argument("unknown key " + key);
+        }
+        catch (const exception &e)
         {
-            average += m;
+            throw invalid_argument(path + ":" + to_string(line) + ": " + e.what());
         }
-        average /= measurements.size();
-        values[i] = average;
+        if (samples == 0 || repeat == 0)
+            throw invalid_argument(path + ":" + to_string(line) + ": samples and repeat must be positive");
     }
+    if (poses.empty())
+        throw invalid_argument(path + ": no pose");
+
+    vector<PosePlan> plan;
+    for (unsigned int r = 0; r < repeat; r++)
+        plan.insert(plan.end(), poses.begin(), poses.end());
+    return plan;
+}
+
+/* ResultWriter */
+ResultWriter::ResultWriter(const string &folder)
+{
+    filesystem::create_directories(folder);
+    results.open(folder + "/results.csv");
+    samples.open(folder + "/samples.csv");
+    if (!results.is_open() || !samples.is_open())
+        throw runtime_error("Cannot write the results in " + folder);
+    results << setprecision(10) << "pose,label,x,y,z,alpha,beta,gamma,samples,valid,mean,devstd,ci95,median,min,max\n";
+    samples << setprecision(10) << "pose,timestamp_ns,distance\n";
+    worker = thread(&ResultWriter::work, this);
+}
+
+ResultWriter::~ResultWriter()
+{
+    close();
+}
 
-    //print results
-    for (float v : values)
+void ResultWriter::push(PoseResult result)
+{
     {
-        cout << v << endl;
+        lock_guard<mutex> lock(queue_mutex);
+        queue.push_back(move(result));
+    }
+    queue_condition.notify_one();
+}
+
+void ResultWriter::close()
+{
+    if (!worker.joinable())
+        return;
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        closing = true;
+    }
+    queue_condition.notify_one();
+    worker.join();
+    results.close();
+    samples.close();
+}
+
+void ResultWriter::work()
+{
+    unique_lock<mutex> lock(queue_mutex);
+    while (true)
+    {
+        queue_condition.wait(lock, [this]
+                             { return !queue.empty() || closing; });
+        if (queue.empty())
+            return;
+        PoseResult result = move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+        write(result);
+        lock.lock();
     }
-    return 0;
 }
 
-void make_measurements(DistanceSensor &sensor, int number_of_measurements, vector<float> &measurements, unsigned int delay_us)
+void ResultWriter::write(const PoseResult &result)
 {
-    float distance;
-    for (int i = 0; i < number_of_measurements; i++)
+    const float *pose = result.plan.pose;
+    results << result.index << "," << result.plan.label;
+    for (int k = 0; k < 6; k++)
+        results << "," << pose[k];
+    results << "," << result.samples.size() << "," << result.stats.count() << "," << result.stats.mean() << ","
+            << result.stats.stddev() << "," << result.stats.confidenceHalfWidth(CONFIDENCE) << "," << result.median.value() << ","
+            << result.stats.min() << "," << result.stats.max() << "\n";
+    results.flush();
+
+    for (const DistanceSample &sample : result.samples)
+        samples << result.index << "," << sample.timestamp_ns << "," << sample.distance_mm << "\n";
+
+    cout << "Pose " << result.index << " (" << result.plan.label << "): " << result.stats.count() << " valid samples, mean "
+         << result.stats.mean() << " +- " << result.stats.confidenceHalfWidth(CONFIDENCE) << " mm" << endl;
+}
+
+map<string, string> parse_command_line(int argc, char *argv[])
+{
+    map<string, string> options;
+
+    for (int i = 1; i < argc; ++i)
     {
-        distance = sensor.getDistanceInMillimeters();
-        measurements.push_back(distance);
-        usleep(delay_us);
+        string arg = argv[i];
+        if (arg.substr(0, 2) == "--")
+        {
+            size_t pos = arg.find('=');
+            string command = pos != string::npos ? arg.substr(2, pos - 2) : arg.substr(2);
+            options[command] = pos != string::npos ? arg.substr(pos + 1) : "";
+        }
     }
+
+    return options;
+}
+
+void display_usage()
+{
+    cout << "Usage: ./duesuperfici [OPTIONS]" << endl
+         << "Options:" << endl
+         << left
+         << "  --" << setw(option_width) << SENSOR_COMMAND "=TYPE" << "Sensor to use (infrared, ultrasonic) [default infrared]" << endl
+         << "  --" << setw(option_width) << PLAN_COMMAND "=FILE" << "Poses and samples of the experiment (see twosurfaces_test/plan.txt) [default: the two surfaces 6 times]" << endl
+         << "  --" << setw(option_width) << PORT_COMMAND "=PATH" << "Serial port of the infrared sensor [default: every sensor found]" << endl
+         << "  --" << setw(option_width) << GPIO_COMMAND "=BACKEND" << "GPIO backend of the ultrasonic sensor: pigpio, gpiod[:/dev/gpiochipN], simulated[:PROFILE[@NOISE]]" << endl
+         << "  --" << setw(option_width) << OUTPUT_COMMAND "=FOLDER" << "Folder of results.csv and samples.csv [default " << OUTPUT_DEFAULT << "]" << endl
+         << "  --" << setw(option_width) << NOROBOT_COMMAND << "Set the poses by hand instead of moving the meca500" << endl;
 }
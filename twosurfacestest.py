@@ -1,13 +1,21 @@
+import csv
+import os
+import sys
 import numpy as np
 import matplotlib.pyplot as plt
 import matplotlib.colors as mcolors
 
+def read_results(path):
+    # mean of every pose from the results.csv written by duesuperfici, in the order of the poses
+    with open(path) as results_file:
+        return [float(row['mean']) for row in csv.DictReader(results_file)]
+
 def create_grid(values, threshold):
     # Convert the list of values to a NumPy array
     values_array = np.array(values)
 
-    # Set the desired number of columns
-    num_columns = 12
+    # One column for each pose
+    num_columns = len(values)
 
     # Calculate the number of rows needed
     num_rows = int(np.ceil(len(values) / num_columns))
@@ -18,7 +26,7 @@ def create_grid(values, threshold):
     # Apply the threshold to create a binary array (0 if below threshold, 1 if above)
     binary_array = (values_array >= threshold).astype(int)
 
-    # Reshape the 1D array into a grid with 1 row and 12 columns
+    # Reshape the 1D array into a grid with 1 row and a column for each pose
     binary_grid = binary_array.reshape((1, num_columns))
 
     return binary_grid
@@ -47,17 +55,25 @@ def plot_grid(binary_grid, values_list):
     plt.show()
 
 if __name__ == "__main__":
-    # Example list of values
-    values_list = [
-        72.528, 75.72, 74.0687, 75.2485, 74.2824,
-        75.0183, 74.3466, 74.8412, 74.328, 74.7372,
-        74.3287, 74.672
-    ]
-
-    # Set the threshold
-    threshold_value = 74.5
-
-    # Create the binary grid with 1 row and 12 columns
+    # usage: python3 twosurfacestest.py [results.csv [threshold]]
+    results_path = sys.argv[1] if len(sys.argv) > 1 else "twosurfaces_test/results.csv"
+    if os.path.exists(results_path):
+        values_list = read_results(results_path)
+        threshold_value = float(np.mean(values_list))
+    else:
+        # Example list of values (twosurfaces_test/twosurfacescheckresults.txt)
+        values_list = [
+            72.528, 75.72, 74.0687, 75.2485, 74.2824,
+            75.0183, 74.3466, 74.8412, 74.328, 74.7372,
+            74.3287, 74.672
+        ]
+        threshold_value = 74.5
+
+    # Set the threshold, by default the mean of all the poses
+    if len(sys.argv) > 2:
+        threshold_value = float(sys.argv[2])
+
+    # Create the binary grid with 1 row and a column for each pose
     binary_grid = create_grid(values_list, threshold_value)
 
     # Plot the binary grid with grid lines and index labels